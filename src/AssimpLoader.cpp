@@ -34,6 +34,10 @@ THE SOFTWARE.
 -----------------------------------------------------------------------------
 */
 #include "AssimpLoader.h"
+#include "LogSink.h"
+#include "MeshBlobSerializer.h"
+#include "MeshPostProcess.h"
+#include "SceneCache.h"
 
 #include <assimp/postprocess.h>
 #include <assimp/Importer.hpp>
@@ -43,94 +47,1294 @@ THE SOFTWARE.
 
 #include <Ogre.h>
 
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
 typedef Ogre::Affine3 Affine3;
 
 struct OgreLogStream : public Assimp::LogStream
 {
-    Ogre::LogMessageLevel _lml;
-    OgreLogStream(Ogre::LogMessageLevel lml) : _lml(lml) {}
+    LogSink::Level _level;
+    OgreLogStream(LogSink::Level level) : _level(level) {}
+
+    // called on the importing thread, the sink trims and writes the message on its own
+    void write(const char* message)
+    {
+        LogSink::getSingleton().log(_level, NULL, "Assimp: %s", message);
+    }
+};
+
+static void addDependency(Ogre::StringVector& dependencies, const Ogre::String& file)
+{
+    if (std::find(dependencies.begin(), dependencies.end(), file) == dependencies.end())
+        dependencies.push_back(file);
+}
+
+/// hash of the contents of a file, 0 if it can not be read
+static Ogre::uint64 hashFile(const Ogre::String& path)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return 0;
+    std::vector<char> chunk(1 << 16);
+    Ogre::uint64 h = MeshBlobSerializer::hash(NULL, 0);
+    while (file.read(chunk.data(), chunk.size()) || file.gcount())
+        h = MeshBlobSerializer::hash(chunk.data(), size_t(file.gcount()), h);
+    return h;
+}
+
+/// names of the auxiliary files the main file references, found without parsing it
+static Ogre::StringVector findExternalFiles(const Ogre::uint8* data, size_t length, const Ogre::String& type)
+{
+    Ogre::StringVector files;
+    if (type == "gltf")
+    {
+        // every "uri" of the buffers and images, except embedded data
+        const char* text = reinterpret_cast<const char*>(data);
+        const char* end = text + length;
+        static const char key[] = "\"uri\"";
+        for (const char* pos = std::search(text, end, key, key + 5); pos != end; pos = std::search(pos, end, key, key + 5))
+        {
+            pos += 5;
+            const char* open = std::find(pos, end, '"');
+            const char* close = open == end ? end : std::find(open + 1, end, '"');
+            if (close == end)
+                break;
+            Ogre::String uri(open + 1, close);
+            if (uri.compare(0, 5, "data:") != 0)
+                files.push_back(uri);
+            pos = close;
+        }
+    }
+    else if (type == "obj")
+    {
+        // material libraries are declared at the top
+        Ogre::MemoryDataStream header(const_cast<Ogre::uint8*>(data), std::min<size_t>(length, 64 * 1024));
+        while (!header.eof())
+        {
+            Ogre::String line = header.getLine();
+            if (Ogre::StringUtil::startsWith(line, "mtllib", false))
+            {
+                Ogre::StringVector names = Ogre::StringUtil::split(line.substr(6));
+                files.insert(files.end(), names.begin(), names.end());
+            }
+        }
+    }
+    return files;
+}
+
+/// serves the main stream from memory and everything else from the resource group
+struct OgreIOSystem : public Assimp::IOSystem
+{
+    /// an auxiliary file read in the background
+    struct Prefetch
+    {
+        std::future<void> done;
+        Ogre::uint8* data;
+        size_t size;
+    };
+
+    const Ogre::uint8* _buffer;
+    size_t _length;
+    Ogre::String _group;
+    Ogre::StringVector* _dependencies;
+
+    // LP_INDEX_RESOURCES, resource names of the group and the resource behind each file name,
+    // empty if several resources share it
+    bool _indexed;
+    std::unordered_set<Ogre::String> _index;
+    std::unordered_map<Ogre::String, Ogre::String> _byFileName;
+    std::map<Ogre::String, Prefetch> _prefetches;
+
+    mutable AssimpLoader::IOStats _stats;
+
+    OgreIOSystem() : _buffer(NULL), _length(0), _dependencies(NULL), _indexed(false) {}
+    ~OgreIOSystem() { clearPrefetches(); }
+
+    /// points the handler at the data of the next load
+    void reset(Ogre::MemoryDataStream* mainStream, const Ogre::String& group, Ogre::StringVector* dependencies,
+               int params = 0, const Ogre::String& type = Ogre::BLANKSTRING)
+    {
+        clearPrefetches();
+        _buffer = mainStream ? mainStream->getPtr() : NULL;
+        _length = mainStream ? mainStream->size() : 0;
+        _group = group;
+        _dependencies = dependencies;
+        _stats = AssimpLoader::IOStats();
+
+        _indexed = (params & AssimpLoader::LP_INDEX_RESOURCES) != 0;
+        _index.clear();
+        _byFileName.clear();
+        if (_indexed)
+        {
+            auto start = std::chrono::steady_clock::now();
+            Ogre::StringVectorPtr names = Ogre::ResourceGroupManager::getSingleton().listResourceNames(group);
+            for (const Ogre::String& name : *names)
+            {
+                _index.insert(name);
+                // names in subfolders of archives, without the folder
+                size_t slash = name.find_last_of('/');
+                auto entry = _byFileName.insert(std::make_pair(slash != Ogre::String::npos ? name.substr(slash + 1) : name, name));
+                if (!entry.second && entry.first->second != name)
+                    entry.first->second.clear();
+            }
+            _stats.indexedNames = _index.size();
+            _stats.indexSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        if (mainStream && (params & AssimpLoader::LP_PREFETCH_EXTERNALS))
+        {
+            Ogre::String extension = type;
+            Ogre::StringUtil::toLowerCase(extension);
+            for (const Ogre::String& file : findExternalFiles(_buffer, _length, extension))
+                prefetch(file);
+        }
+    }
+
+    /// the group and the resources the auxiliary files of the main stream resolve to, which a stream leaves open
+    Ogre::String describeExternals(const Ogre::String& type) const
+    {
+        // not a lookup of the load
+        AssimpLoader::IOStats stats = _stats;
+        Ogre::String extension = type;
+        Ogre::StringUtil::toLowerCase(extension);
+        Ogre::String description = _group;
+        for (const Ogre::String& file : findExternalFiles(_buffer, _length, extension))
+        {
+            description += '\0';
+            description += resolve(file.c_str());
+        }
+        _stats = stats;
+        return description;
+    }
+
+    static bool isMainStream(const char* pFile)
+    {
+        return strncmp(pFile, AI_MEMORYIO_MAGIC_FILENAME, AI_MEMORYIO_MAGIC_FILENAME_LENGTH) == 0;
+    }
+
+    /// the resource name for pFile, empty if the index has none
+    Ogre::String resolve(const char* pFile) const
+    {
+        Ogre::String name(pFile);
+        std::replace(name.begin(), name.end(), '\\', '/');
+        while (name.compare(0, 2, "./") == 0)
+            name.erase(0, 2);
+        if (!_indexed)
+            return name;
+
+        _stats.lookups++;
+        if (_index.count(name))
+            return name;
+
+        size_t slash = name.find_last_of('/');
+        auto it = _byFileName.find(slash != Ogre::String::npos ? name.substr(slash + 1) : name);
+        if (it == _byFileName.end())
+        {
+            // answered without asking every archive of the group
+            _stats.indexMisses++;
+            return Ogre::BLANKSTRING;
+        }
+        // a file name of several resources is left to the group to resolve, as without the index
+        return it->second.empty() ? name : it->second;
+    }
+
+    /// opens file on this thread and reads it on another
+    void prefetch(const Ogre::String& file)
+    {
+        Ogre::String name = resolve(file.c_str());
+        if (name.empty() || _prefetches.count(name))
+            return;
+        Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(name, _group, NULL, false);
+        if (!stream)
+            return;
+
+        Prefetch& prefetch = _prefetches[name];
+        prefetch.data = NULL;
+        prefetch.size = 0;
+        // the map does not move its entries, a stream of unknown size is read by open as usual
+        prefetch.done = std::async(std::launch::async, [stream, &prefetch]() {
+            if (!stream->size())
+                return;
+            prefetch.data = new Ogre::uint8[stream->size()];
+            prefetch.size = stream->read(prefetch.data, stream->size());
+        });
+        _stats.prefetchedFiles++;
+    }
+
+    void clearPrefetches()
+    {
+        for (auto& prefetch : _prefetches)
+        {
+            if (prefetch.second.done.valid())
+                prefetch.second.done.wait();
+            delete[] prefetch.second.data;
+        }
+        _prefetches.clear();
+    }
+
+    bool Exists(const char* pFile) const override
+    {
+        if (isMainStream(pFile))
+            return true;
+        Ogre::String name = resolve(pFile);
+        if (name.empty())
+            return false;
+        if (_prefetches.count(name))
+            return true;
+        return Ogre::ResourceGroupManager::getSingleton().resourceExists(_group, name);
+    }
+
+    char getOsSeparator() const override { return '/'; }
+
+    Assimp::IOStream* Open(const char* pFile, const char* pMode) override
+    {
+        if (isMainStream(pFile))
+            return new Assimp::MemoryIOStream(_buffer, _length, false);
+
+        auto start = std::chrono::steady_clock::now();
+        Assimp::IOStream* ret = open(pFile);
+        _stats.openSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return ret;
+    }
+
+    Assimp::IOStream* open(const char* pFile)
+    {
+        Ogre::String name = resolve(pFile);
+        if (name.empty())
+            return NULL;
+
+        auto prefetched = _prefetches.find(name);
+        if (prefetched != _prefetches.end() && prefetched->second.done.valid())
+        {
+            auto start = std::chrono::steady_clock::now();
+            prefetched->second.done.get();
+            _stats.prefetchWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (prefetched != _prefetches.end() && prefetched->second.data)
+        {
+            _stats.prefetchHits++;
+            _stats.prefetchBytes += prefetched->second.size;
+            addDependency(*_dependencies, pFile);
+
+            // the stream takes the data, a second open reads the file again
+            Ogre::uint8* data = prefetched->second.data;
+            prefetched->second.data = NULL;
+            return new Assimp::MemoryIOStream(data, prefetched->second.size, true);
+        }
+
+        auto ret = Ogre::ResourceGroupManager::getSingleton().openResource(name, _group, NULL, false);
+        if (ret)
+        {
+            addDependency(*_dependencies, pFile);
+            Ogre::MemoryDataStream buffer(ret, false);
+            return new Assimp::MemoryIOStream(buffer.getPtr(), buffer.size(), true);
+        }
+        return NULL;
+    }
+
+    void Close(Assimp::IOStream* pFile) override
+    {
+        delete pFile;
+    }
+};
+
+/// records the files Assimp opens from disk
+struct RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+    Ogre::StringVector* _dependencies;
+
+    RecordingIOSystem() : _dependencies(NULL) {}
+
+    Assimp::IOStream* Open(const char* pFile, const char* pMode) override
+    {
+        Assimp::IOStream* ret = Assimp::DefaultIOSystem::Open(pFile, pMode);
+        if (ret && _dependencies)
+            addDependency(*_dependencies, pFile);
+        return ret;
+    }
+};
+
+/// forwards Assimp's progress to the loader, installed once per pooled importer
+struct LoadProgressHandler : public Assimp::ProgressHandler
+{
+    std::function<bool(AssimpLoader::LoadPhase, float)> report;
+    AssimpLoader::LoadPhase phase;
+    bool cancelled;
+
+    LoadProgressHandler() : phase(AssimpLoader::PHASE_PARSE), cancelled(false) {}
+
+    void reset(const std::function<bool(AssimpLoader::LoadPhase, float)>& callback)
+    {
+        report = callback;
+        phase = AssimpLoader::PHASE_PARSE;
+        cancelled = false;
+    }
+
+    /** every report ends up here, parsing is [0, 0.5] and post processing [0.5, 1] like in the base class
+
+        Assimp aborts the import where it checks the return value, it also calls this with -1 to
+        only ask whether to go on.
+    */
+    bool Update(float percentage) override
+    {
+        if (report && !cancelled && percentage >= 0)
+        {
+            float progress = phase == AssimpLoader::PHASE_PARSE ? percentage * 2 : percentage * 2 - 1;
+            cancelled = !report(phase, std::max(0.0f, std::min(1.0f, progress)));
+        }
+        return !cancelled;
+    }
+
+    void UpdateFileRead(int currentStep, int numberOfSteps) override
+    {
+        phase = AssimpLoader::PHASE_PARSE;
+        Update(fraction(currentStep, numberOfSteps) * 0.5f);
+    }
+
+    void UpdatePostProcess(int currentStep, int numberOfSteps) override
+    {
+        phase = AssimpLoader::PHASE_POSTPROCESS;
+        Update(0.5f + fraction(currentStep, numberOfSteps) * 0.5f);
+    }
+
+    static float fraction(int currentStep, int numberOfSteps)
+    {
+        return numberOfSteps > 0 ? std::min(1.0f, float(currentStep) / numberOfSteps) : 1.0f;
+    }
+};
+
+/** Importers of the calling thread
+
+    Constructing an importer registers every file format and post processing step, which
+    dominates loading small files. So each thread keeps one importer per IO handler type
+    and reuses it for all loads. The importers own their IO and progress handlers.
+*/
+struct ImporterPool
+{
+    Assimp::Importer fileImporter;
+    Assimp::Importer streamImporter;
+    RecordingIOSystem* fileIO;
+    OgreIOSystem* streamIO;
+    LoadProgressHandler* fileProgress;
+    LoadProgressHandler* streamProgress;
+
+    ImporterPool()
+        : fileIO(new RecordingIOSystem()), streamIO(new OgreIOSystem()), fileProgress(new LoadProgressHandler()),
+          streamProgress(new LoadProgressHandler())
+    {
+        fileImporter.SetIOHandler(fileIO);
+        streamImporter.SetIOHandler(streamIO);
+        fileImporter.SetProgressHandler(fileProgress);
+        streamImporter.SetProgressHandler(streamProgress);
+    }
+
+    static ImporterPool& get()
+    {
+        static thread_local ImporterPool pool;
+        return pool;
+    }
+};
+
+/// writes tangent and handedness to dst as normalised integers
+static void packTangent(Ogre::uint8* dst, Ogre::VertexElementType type, const aiVector3D& tangent, float handedness)
+{
+    float t[4] = {tangent.x, tangent.y, tangent.z, handedness};
+    if (type == Ogre::VET_SHORT4_NORM)
+    {
+        Ogre::int16 packed[4];
+        for (int i = 0; i < 4; ++i)
+            packed[i] = Ogre::int16(Ogre::Math::Clamp(t[i], -1.0f, 1.0f) * 32767.0f + (t[i] < 0 ? -0.5f : 0.5f));
+        memcpy(dst, packed, sizeof(packed));
+        return;
+    }
+
+    // signed 10 bit x, y, z and a 2 bit w, x in the low bits
+    Ogre::uint32 packed = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        Ogre::int32 c = Ogre::int32(Ogre::Math::Clamp(t[i], -1.0f, 1.0f) * 511.0f + (t[i] < 0 ? -0.5f : 0.5f));
+        packed |= Ogre::uint32(c & 0x3FF) << (10 * i);
+    }
+    packed |= Ogre::uint32((handedness < 0 ? -1 : 1) & 0x3) << 30;
+    memcpy(dst, &packed, sizeof(packed));
+}
+
+static void countMeshUses(const aiNode* pNode, std::vector<unsigned int>& useCount)
+{
+    for (unsigned int i = 0; i < pNode->mNumMeshes; ++i)
+        useCount[pNode->mMeshes[i]]++;
+
+    for (unsigned int i = 0; i < pNode->mNumChildren; ++i)
+        countMeshUses(pNode->mChildren[i], useCount);
+}
+
+/// frees the vertex, face and bone arrays of mesh and returns their size in bytes
+static size_t releaseMeshData(aiMesh* mesh)
+{
+    size_t bytes = 0;
+    auto release = [&bytes, mesh](aiVector3D*& array, unsigned int components) {
+        if (!array)
+            return;
+        bytes += mesh->mNumVertices * components * sizeof(ai_real);
+        delete[] array;
+        array = NULL;
+    };
+
+    release(mesh->mVertices, 3);
+    release(mesh->mNormals, 3);
+    release(mesh->mTangents, 3);
+    release(mesh->mBitangents, 3);
+    for (unsigned int i = 0; i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
+        release(mesh->mTextureCoords[i], 3);
+    for (unsigned int i = 0; i < AI_MAX_NUMBER_OF_COLOR_SETS; ++i)
+    {
+        if (mesh->mColors[i])
+        {
+            bytes += mesh->mNumVertices * sizeof(aiColor4D);
+            delete[] mesh->mColors[i];
+            mesh->mColors[i] = NULL;
+        }
+    }
+
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+        bytes += sizeof(aiFace) + mesh->mFaces[i].mNumIndices * sizeof(unsigned int);
+    delete[] mesh->mFaces;
+    mesh->mFaces = NULL;
+    mesh->mNumFaces = 0;
+
+    for (unsigned int i = 0; i < mesh->mNumBones; ++i)
+    {
+        bytes += sizeof(aiBone) + mesh->mBones[i]->mNumWeights * sizeof(aiVertexWeight);
+        delete mesh->mBones[i];
+    }
+    delete[] mesh->mBones;
+    mesh->mBones = NULL;
+    mesh->mNumBones = 0;
+
+    mesh->mNumVertices = 0;
+    return bytes;
+}
+
+// serialises looking up and creating shared skeletons
+static std::mutex msSkeletonMutex;
+
+// the Assimp logger is global, it lives as long as any loader does
+static std::mutex msLoggerMutex;
+static int msLoggerUsers = 0;
+static bool msOwnsLogger = false;
+
+AssimpLoader::AssimpLoader()
+    : boneMap(mArena), mBoneNodesByName(mArena), mBonesByName(mArena), mNodeDerivedTransformByName(mArena),
+      mPrunedBones(mArena), mFoldedTransformByName(mArena), mBoneNameMap(NULL), mAppendingAnimations(false), mSkeletonShared(false), mBoneCount(0), mCancelled(false),
+      mUpdateMaterials(false)
+{
+    std::lock_guard<std::mutex> lock(msLoggerMutex);
+    if (msLoggerUsers++ == 0 && Assimp::DefaultLogger::isNullLogger())
+    {
+        Assimp::DefaultLogger::create("");
+        Assimp::DefaultLogger::get()->attachStream(new OgreLogStream(LogSink::LEVEL_DETAIL),
+                                                   Assimp::DefaultLogger::Info | Assimp::DefaultLogger::Debugging);
+        Assimp::DefaultLogger::get()->attachStream(new OgreLogStream(LogSink::LEVEL_INFO),
+                                                   Assimp::DefaultLogger::Warn);
+        Assimp::DefaultLogger::get()->attachStream(new OgreLogStream(LogSink::LEVEL_ERROR),
+                                                   Assimp::DefaultLogger::Err);
+        msOwnsLogger = true;
+    }
+}
+
+AssimpLoader::~AssimpLoader()
+{
+    std::lock_guard<std::mutex> lock(msLoggerMutex);
+    if (--msLoggerUsers == 0 && msOwnsLogger)
+    {
+        Assimp::DefaultLogger::kill();
+        msOwnsLogger = false;
+    }
+}
+
+bool AssimpLoader::load(const Ogre::DataStreamPtr& source, const Ogre::String& type, Ogre::Mesh* mesh,
+                        Ogre::SkeletonPtr& skeletonPtr, const Options& options)
+{
+    ImporterPool& pool = ImporterPool::get();
+    Ogre::MemoryDataStream buffer(source);
+    mDependencies.clear();
+    mSourceDir.clear();
+    pool.streamIO->reset(&buffer, mesh->getGroup(), &mDependencies, options.params, type);
+    pool.streamProgress->reset([this](LoadPhase phase, float progress) { return reportProgress(phase, progress); });
+    auto name = Ogre::StringUtil::format(AI_MEMORYIO_MAGIC_FILENAME ".%s", type.c_str());
+    Ogre::uint64 sourceHash = 0;
+    if (SceneCache::getSingleton().isEnabled())
+    {
+        // the same stream may pick up other auxiliary files from another group
+        Ogre::String externals = pool.streamIO->describeExternals(type);
+        sourceHash = SceneCache::makeKey(MeshBlobSerializer::hash(buffer.getPtr(), buffer.size()), externals.data(), externals.size());
+    }
+    bool ret = _load(name.c_str(), pool.streamImporter, mesh, skeletonPtr, options, sourceHash);
+    mIOStats = pool.streamIO->_stats;
+    pool.streamIO->reset(NULL, Ogre::BLANKSTRING, NULL);
+    logIOStats(options);
+    pool.streamProgress->reset(nullptr);
+    return ret;
+}
+
+bool AssimpLoader::load(const Ogre::String& source, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr,
+                        const AssimpLoader::Options& options)
+{
+    ImporterPool& pool = ImporterPool::get();
+    Ogre::String basename;
+    Ogre::StringUtil::splitFilename(source, basename, mSourceDir);
+    mDependencies.clear();
+    pool.fileIO->_dependencies = &mDependencies;
+    pool.fileProgress->reset([this](LoadPhase phase, float progress) { return reportProgress(phase, progress); });
+    mIOStats = IOStats();
+    Ogre::uint64 sourceHash = SceneCache::getSingleton().isEnabled() ? hashFile(source) : 0;
+    bool ret = _load(source.c_str(), pool.fileImporter, mesh, skeletonPtr, options, sourceHash);
+    pool.fileIO->_dependencies = NULL;
+    pool.fileProgress->reset(nullptr);
+    return ret;
+}
+
+bool AssimpLoader::loadAnimations(const Ogre::DataStreamPtr& source, const Ogre::String& type, const Ogre::SkeletonPtr& skeleton,
+                                  const Options& options)
+{
+    ImporterPool& pool = ImporterPool::get();
+    Ogre::MemoryDataStream buffer(source);
+    mDependencies.clear();
+    mSourceDir.clear();
+    pool.streamIO->reset(&buffer, skeleton->getGroup(), &mDependencies, options.params, type);
+    pool.streamProgress->reset([this](LoadPhase phase, float progress) { return reportProgress(phase, progress); });
+    auto name = Ogre::StringUtil::format(AI_MEMORYIO_MAGIC_FILENAME ".%s", type.c_str());
+    bool ret = _loadAnimations(name.c_str(), pool.streamImporter, skeleton, options);
+    mIOStats = pool.streamIO->_stats;
+    pool.streamIO->reset(NULL, Ogre::BLANKSTRING, NULL);
+    logIOStats(options);
+    pool.streamProgress->reset(nullptr);
+    return ret;
+}
+
+bool AssimpLoader::loadAnimations(const Ogre::String& source, const Ogre::SkeletonPtr& skeleton, const Options& options)
+{
+    ImporterPool& pool = ImporterPool::get();
+    Ogre::String basename;
+    Ogre::StringUtil::splitFilename(source, basename, mSourceDir);
+    mDependencies.clear();
+    pool.fileIO->_dependencies = &mDependencies;
+    pool.fileProgress->reset([this](LoadPhase phase, float progress) { return reportProgress(phase, progress); });
+    mIOStats = IOStats();
+    bool ret = _loadAnimations(source.c_str(), pool.fileImporter, skeleton, options);
+    pool.fileIO->_dependencies = NULL;
+    pool.fileProgress->reset(nullptr);
+    return ret;
+}
+
+void AssimpLoader::logIOStats(const Options& options) const
+{
+    if((options.params & LP_QUIET_MODE) || !(options.params & (LP_INDEX_RESOURCES | LP_PREFETCH_EXTERNALS)))
+        return;
+
+    LOGSINK_LOG(LogSink::LEVEL_INFO, NULL,
+                "Auxiliary files: %zu names indexed in %.3f ms, %zu lookups, %zu misses, %.3f ms opening; "
+                "%zu prefetched, %zu served (%zu bytes), %.3f ms waiting for them",
+                mIOStats.indexedNames, mIOStats.indexSeconds * 1000, mIOStats.lookups, mIOStats.indexMisses, mIOStats.openSeconds * 1000,
+                mIOStats.prefetchedFiles, mIOStats.prefetchHits, mIOStats.prefetchBytes, mIOStats.prefetchWaitSeconds * 1000);
+}
+
+const char* AssimpLoader::SUBMESH_HASHES = "AssimpLoader::SubMeshHashes";
+
+Ogre::MeshPtr AssimpLoader::createReimportMesh(const Ogre::Mesh* mesh)
+{
+    // a unique prefix keeps the skeleton of the scratch mesh apart from the existing one
+    static std::atomic<unsigned int> count(0);
+    return Ogre::MeshManager::getSingleton().createManual("reimport" + Ogre::StringConverter::toString(count++) + "_" + mesh->getName(),
+                                                          mesh->getGroup());
+}
+
+void AssimpLoader::removeReimportMaterials()
+{
+    for (const auto& entry : mUpdatedMaterials)
+        Ogre::MaterialManager::getSingleton().remove(entry.second->getHandle());
+    mUpdatedMaterials.clear();
+}
+
+bool AssimpLoader::reimport(const Ogre::String& source, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr, ReimportResult& result,
+                            const Options& options)
+{
+    Options reimportOptions = options;
+    reimportOptions.chunkSize = 0;
+
+    Ogre::MeshPtr scratch = createReimportMesh(mesh);
+    Ogre::SkeletonPtr newSkeleton;
+    mUpdateMaterials = true;
+    mUpdatedMaterials.clear();
+    bool ret = load(source, scratch.get(), newSkeleton, reimportOptions);
+    mUpdateMaterials = false;
+
+    result = ReimportResult();
+    if (ret)
+        applyReimport(scratch.get(), newSkeleton, mesh, skeletonPtr, result);
+    Ogre::MeshManager::getSingleton().remove(scratch->getHandle());
+    removeReimportMaterials();
+    return ret;
+}
+
+bool AssimpLoader::reimport(const Ogre::DataStreamPtr& source, const Ogre::String& type, Ogre::Mesh* mesh,
+                            Ogre::SkeletonPtr& skeletonPtr, ReimportResult& result, const Options& options)
+{
+    Options reimportOptions = options;
+    reimportOptions.chunkSize = 0;
+
+    Ogre::MeshPtr scratch = createReimportMesh(mesh);
+    Ogre::SkeletonPtr newSkeleton;
+    mUpdateMaterials = true;
+    mUpdatedMaterials.clear();
+    bool ret = load(source, type, scratch.get(), newSkeleton, reimportOptions);
+    mUpdateMaterials = false;
+
+    result = ReimportResult();
+    if (ret)
+        applyReimport(scratch.get(), newSkeleton, mesh, skeletonPtr, result);
+    Ogre::MeshManager::getSingleton().remove(scratch->getHandle());
+    removeReimportMaterials();
+    return ret;
+}
+
+/// keyframes of anim, for finding the clips a reimport changed
+static Ogre::uint64 hashAnimation(const Ogre::Animation* anim)
+{
+    std::vector<float> data(1, anim->getLength());
+    for (const auto& entry : anim->_getNodeTrackList())
+    {
+        const Ogre::NodeAnimationTrack* track = entry.second;
+        data.push_back(float(entry.first));
+        for (unsigned short k = 0; k < track->getNumKeyFrames(); ++k)
+        {
+            const Ogre::TransformKeyFrame* key = track->getNodeKeyFrame(k);
+            const Ogre::Vector3& t = key->getTranslate();
+            const Ogre::Quaternion& r = key->getRotation();
+            const Ogre::Vector3& s = key->getScale();
+            data.insert(data.end(), {key->getTime(), t.x, t.y, t.z, r.w, r.x, r.y, r.z, s.x, s.y, s.z});
+        }
+    }
+    return MeshBlobSerializer::hash(data.data(), data.size() * sizeof(float));
+}
+
+/// replaces the tracks of dst by those of src, dstSkeleton has bones of the same names
+static void copyTracks(const Ogre::Animation* src, Ogre::Animation* dst, Ogre::Skeleton* dstSkeleton)
+{
+    dst->setLength(src->getLength());
+    dst->setInterpolationMode(src->getInterpolationMode());
+
+    // the bones are resolved by name, the handles of both skeletons need not match
+    std::set<unsigned short> handles;
+    for (const auto& entry : src->_getNodeTrackList())
+    {
+        Ogre::Bone* bone = dstSkeleton->getBone(entry.second->getAssociatedNode()->getName());
+        handles.insert(bone->getHandle());
+        Ogre::NodeAnimationTrack* track = dst->hasNodeTrack(bone->getHandle())
+                                              ? dst->getNodeTrack(bone->getHandle())
+                                              : dst->createNodeTrack(bone->getHandle(), bone);
+        track->removeAllKeyFrames();
+        for (unsigned short k = 0; k < entry.second->getNumKeyFrames(); ++k)
+        {
+            const Ogre::TransformKeyFrame* key = entry.second->getNodeKeyFrame(k);
+            Ogre::TransformKeyFrame* copy = track->createNodeKeyFrame(key->getTime());
+            copy->setTranslate(key->getTranslate());
+            copy->setRotation(key->getRotation());
+            copy->setScale(key->getScale());
+        }
+    }
+
+    std::vector<unsigned short> stale;
+    for (const auto& entry : dst->_getNodeTrackList())
+    {
+        if (!handles.count(entry.first))
+            stale.push_back(entry.first);
+    }
+    for (unsigned short handle : stale)
+        dst->destroyNodeTrack(handle);
+}
+
+/// same bones, handles and hierarchy as skeleton, linked animations are applied by handle
+static void copyBones(const Ogre::Skeleton* skeleton, Ogre::Skeleton* target)
+{
+    for(unsigned short h = 0; h < skeleton->getNumBones(); ++h)
+    {
+        Ogre::Bone* src = skeleton->getBone(h);
+        Ogre::Bone* bone = target->createBone(src->getName(), h);
+        bone->setPosition(src->getPosition());
+        bone->setOrientation(src->getOrientation());
+        bone->setScale(src->getScale());
+    }
+    for(unsigned short h = 0; h < skeleton->getNumBones(); ++h)
+    {
+        Ogre::Node* parent = skeleton->getBone(h)->getParent();
+        if(parent)
+        {
+            target->getBone(parent->getName())->addChild(target->getBone(h));
+        }
+    }
+    target->setBindingPose();
+}
+
+/** hands the geometry of src to dst, dst stays the same object
+
+    Buffers of the same layout and size are written in place. Returns false if dst got new vertex
+    data or buffers instead, which entities and their temporary buffers still refer to.
+*/
+static bool moveSubMesh(Ogre::SubMesh* src, Ogre::SubMesh* dst)
+{
+    Ogre::VertexBufferBinding* srcBinding = src->vertexData->vertexBufferBinding;
+    Ogre::VertexBufferBinding* dstBinding = dst->vertexData->vertexBufferBinding;
+    bool sameVertices = !dst->useSharedVertices &&
+                        src->vertexData->vertexDeclaration->getElements() == dst->vertexData->vertexDeclaration->getElements() &&
+                        src->vertexData->vertexCount == dst->vertexData->vertexCount &&
+                        srcBinding->getBindings().size() == dstBinding->getBindings().size();
+    for (const auto& binding : srcBinding->getBindings())
+    {
+        sameVertices = sameVertices && dstBinding->isBufferBound(binding.first) &&
+                       dstBinding->getBuffer(binding.first)->getSizeInBytes() == binding.second->getSizeInBytes();
+    }
+    const Ogre::IndexData* srcIndices = src->indexData;
+    Ogre::IndexData* dstIndices = dst->indexData;
+    const bool sameIndices = srcIndices->indexBuffer && dstIndices->indexBuffer &&
+                             srcIndices->indexBuffer->getType() == dstIndices->indexBuffer->getType() &&
+                             srcIndices->indexBuffer->getSizeInBytes() == dstIndices->indexBuffer->getSizeInBytes();
+
+    if (sameVertices)
+    {
+        for (const auto& binding : srcBinding->getBindings())
+            dstBinding->getBuffer(binding.first)->copyData(*binding.second, 0, 0, binding.second->getSizeInBytes(), true);
+        dst->vertexData->vertexStart = src->vertexData->vertexStart;
+    }
+    else
+    {
+        // the scratch mesh deletes the old vertex data
+        std::swap(dst->vertexData, src->vertexData);
+        src->useSharedVertices = dst->useSharedVertices;
+        dst->useSharedVertices = false;
+    }
+    if (sameIndices)
+        dstIndices->indexBuffer->copyData(*srcIndices->indexBuffer, 0, 0, srcIndices->indexBuffer->getSizeInBytes(), true);
+    else
+        dstIndices->indexBuffer = srcIndices->indexBuffer;
+    dstIndices->indexStart = srcIndices->indexStart;
+    dstIndices->indexCount = srcIndices->indexCount;
+    dst->operationType = src->operationType;
+
+    dst->clearBoneAssignments();
+    for (const auto& vba : src->getBoneAssignments())
+        dst->addBoneAssignment(vba.second);
+    dst->blendIndexToBoneIndexMap = src->blendIndexToBoneIndexMap;
+
+    dst->setMaterialName(src->getMaterialName());
+    return sameVertices && sameIndices;
+}
+
+void AssimpLoader::applyReimport(Ogre::Mesh* scratch, Ogre::SkeletonPtr& newSkeleton, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr,
+                                 ReimportResult& result)
+{
+    // the load succeeded, only now the existing materials take the new parameters
+    for (const auto& entry : mUpdatedMaterials)
+    {
+        Ogre::MaterialPtr target = Ogre::MaterialManager::getSingleton().getByName(entry.first, entry.second->getGroup());
+        if (target)
+            entry.second->copyDetailsTo(target);
+    }
+    result.materialsUpdated = mUpdatedMaterials.size();
+
+    bool skeletonReplaced = false;
+    if (newSkeleton != skeletonPtr)
+    {
+        if (newSkeleton && skeletonPtr && hashSkeleton(newSkeleton.get()) == hashSkeleton(skeletonPtr.get()))
+        {
+            for (unsigned short i = 0; i < newSkeleton->getNumAnimations(); ++i)
+            {
+                const Ogre::Animation* src = newSkeleton->getAnimation(i);
+                if (!skeletonPtr->hasAnimation(src->getName()))
+                {
+                    copyTracks(src, skeletonPtr->createAnimation(src->getName(), src->getLength()), skeletonPtr.get());
+                    result.animationsAdded++;
+                }
+                else if (hashAnimation(src) != hashAnimation(skeletonPtr->getAnimation(src->getName())))
+                {
+                    copyTracks(src, skeletonPtr->getAnimation(src->getName()), skeletonPtr.get());
+                    result.animationsUpdated++;
+                }
+                else
+                {
+                    result.animationsUnchanged++;
+                }
+            }
+
+            Ogre::StringVector stale;
+            for (unsigned short i = 0; i < skeletonPtr->getNumAnimations(); ++i)
+            {
+                if (!newSkeleton->hasAnimation(skeletonPtr->getAnimation(i)->getName()))
+                    stale.push_back(skeletonPtr->getAnimation(i)->getName());
+            }
+            for (const Ogre::String& name : stale)
+                skeletonPtr->removeAnimation(name);
+            result.animationsRemoved = stale.size();
+
+            if (!mSkeletonShared)
+                Ogre::SkeletonManager::getSingleton().remove(newSkeleton->getHandle());
+        }
+        else
+        {
+            // the bones changed, so the bone assignments refer to the new skeleton
+            skeletonReplaced = true;
+
+            Ogre::String scratchBase, meshBase, extension;
+            Ogre::StringUtil::splitBaseFilename(scratch->getName(), scratchBase, extension);
+            Ogre::StringUtil::splitBaseFilename(mesh->getName(), meshBase, extension);
+            if (newSkeleton && newSkeleton->getName() == scratchBase + ".skeleton")
+            {
+                // take the name a load of the mesh gives its skeleton instead of the scratch one
+                Ogre::SkeletonManager& skelMgr = Ogre::SkeletonManager::getSingleton();
+                Ogre::SkeletonPtr previous = skelMgr.getByName(meshBase + ".skeleton", newSkeleton->getGroup());
+                if (previous)
+                    skelMgr.remove(previous->getHandle());
+
+                Ogre::SkeletonPtr renamed = skelMgr.create(meshBase + ".skeleton", newSkeleton->getGroup(), true);
+                copyBones(newSkeleton.get(), renamed.get());
+                for (unsigned short i = 0; i < newSkeleton->getNumAnimations(); ++i)
+                {
+                    const Ogre::Animation* src = newSkeleton->getAnimation(i);
+                    copyTracks(src, renamed->createAnimation(src->getName(), src->getLength()), renamed.get());
+                }
+                skelMgr.remove(newSkeleton->getHandle());
+                newSkeleton = renamed;
+            }
+            skeletonPtr = newSkeleton;
+            mesh->setSkeletonName(newSkeleton ? newSkeleton->getName() : Ogre::BLANKSTRING);
+        }
+    }
+
+    const std::vector<Ogre::uint64>* oldHashes =
+        Ogre::any_cast<std::vector<Ogre::uint64> >(&mesh->getUserObjectBindings().getUserAny(SUBMESH_HASHES));
+    const unsigned short common = std::min(mesh->getNumSubMeshes(), scratch->getNumSubMeshes());
+    bool buffersReplaced = false;
+    for (unsigned short i = 0; i < common; ++i)
+    {
+        if (!skeletonReplaced && oldHashes && i < oldHashes->size() && i < mSubMeshHashes.size() &&
+            (*oldHashes)[i] == mSubMeshHashes[i])
+        {
+            result.subMeshesUnchanged++;
+            continue;
+        }
+        if (!moveSubMesh(scratch->getSubMesh(i), mesh->getSubMesh(i)))
+            buffersReplaced = true;
+        result.subMeshesUpdated++;
+    }
+    while (mesh->getNumSubMeshes() > scratch->getNumSubMeshes())
+    {
+        mesh->destroySubMesh(mesh->getNumSubMeshes() - 1);
+        result.subMeshesRemoved++;
+    }
+    Ogre::Mesh::SubMeshNameMap names;
+    for (const auto& entry : scratch->getSubMeshNameMap())
+        names[entry.first] = entry.second;
+    for (unsigned short i = common; i < scratch->getNumSubMeshes(); ++i)
+    {
+        Ogre::SubMesh* added = mesh->createSubMesh();
+        added->useSharedVertices = false;
+        added->vertexData = new Ogre::VertexData();
+        moveSubMesh(scratch->getSubMesh(i), added);
+        for (const auto& entry : names)
+        {
+            if (entry.second == i)
+                mesh->nameSubMesh(entry.first, i);
+        }
+        result.subMeshesAdded++;
+    }
+
+    if (result.subMeshesUpdated || result.subMeshesAdded || result.subMeshesRemoved)
+    {
+        // both were built from the old geometry
+        if (mesh->getNumLodLevels() > 1)
+        {
+            mesh->removeLodLevels();
+            result.lodsRemoved = true;
+        }
+        if (mesh->isEdgeListBuilt())
+        {
+            mesh->freeEdgeList();
+            mesh->buildEdgeList();
+        }
+    }
+
+    result.rebuilt = skeletonReplaced || buffersReplaced || result.lodsRemoved || result.subMeshesAdded || result.subMeshesRemoved;
+
+    mesh->_setBounds(scratch->getBounds(), false);
+    mesh->_setBoundingSphereRadius(scratch->getBoundingSphereRadius());
+    mesh->getUserObjectBindings().setUserAny(SUBMESH_HASHES, Ogre::Any(mSubMeshHashes));
+
+    if(!mQuietMode)
+    {
+        Ogre::LogManager::getSingleton().logMessage(Ogre::StringUtil::format(
+            "Reimport of %s: %zu submeshes unchanged, %zu updated, %zu added, %zu removed; "
+            "%zu animations unchanged, %zu updated, %zu added, %zu removed; %zu materials updated",
+            mesh->getName().c_str(), result.subMeshesUnchanged, result.subMeshesUpdated, result.subMeshesAdded,
+            result.subMeshesRemoved, result.animationsUnchanged, result.animationsUpdated, result.animationsAdded,
+            result.animationsRemoved, result.materialsUpdated));
+    }
+}
+
+/// runs task(i) for every i below count on up to threads threads, the calling one included
+static void parallelFor(size_t count, unsigned int threads, const std::function<void(size_t)>& task)
+{
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < std::min<size_t>(threads, count); ++t)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& w : workers)
+    {
+        w.join();
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+const aiScene* AssimpLoader::postProcessInParallel(Assimp::Importer& importer, const Options& options)
+{
+    // the steps a serial load would run
+    Options serial = options;
+    serial.params &= ~LP_PARALLEL_POSTPROCESS;
+    int removeComponents;
+    const Ogre::uint32 flags = getPostProcessFlags(serial, removeComponents);
+    const unsigned int threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    // the importer keeps the scene, its meshes are changed in place like its own steps do
+    aiScene* scene = const_cast<aiScene*>(importer.GetScene());
+    std::atomic<unsigned int> verticesJoined(0);
+    parallelFor(scene->mNumMeshes, threads, [&](size_t i) {
+        aiMesh* mesh = scene->mMeshes[i];
+        if(flags & aiProcess_GenSmoothNormals)
+            MeshPostProcess::generateSmoothNormals(mesh, options.maxEdgeAngle);
+        if(flags & aiProcess_CalcTangentSpace)
+            MeshPostProcess::calcTangentSpace(mesh);
+        if(flags & aiProcess_JoinIdenticalVertices)
+            verticesJoined += MeshPostProcess::joinIdenticalVertices(mesh);
+    });
+
+    if(!(options.params & LP_QUIET_MODE))
+    {
+        Ogre::LogManager::getSingleton().logMessage(Ogre::StringUtil::format(
+            "Post processed %u meshes on %u threads, %u vertices joined", scene->mNumMeshes, threads, unsigned(verticesJoined)));
+    }
+
+    const Ogre::uint32 remaining = flags & (aiProcess_ImproveCacheLocality | aiProcess_SplitLargeMeshes);
+    return remaining ? importer.ApplyPostProcessing(remaining) : scene;
+}
+
+Ogre::uint32 AssimpLoader::getPostProcessFlags(const Options& options, int& removeComponents)
+{
+    Ogre::uint32 flags = aiProcessPreset_TargetRealtime_Quality | aiProcess_TransformUVCoords | aiProcess_FlipUVs;
+    removeComponents = 0;
+
+    int params = options.params;
+    if(params & LP_GEOMETRY_ONLY)
+    {
+        params |= LP_SKIP_MATERIALS | LP_SKIP_NORMALS | LP_SKIP_UVS;
+        removeComponents |= aiComponent_BONEWEIGHTS | aiComponent_ANIMATIONS | aiComponent_COLORS;
+        flags &= ~aiProcess_LimitBoneWeights;
+    }
+    if(params & LP_ANIMATIONS_ONLY)
+    {
+        // meshes stay as their bones define the skeleton, but none of their attributes are needed
+        params |= LP_SKIP_MATERIALS | LP_SKIP_NORMALS | LP_SKIP_UVS;
+        removeComponents |= aiComponent_COLORS;
+        flags &= ~(aiProcess_ImproveCacheLocality | aiProcess_FindDegenerates | aiProcess_FindInvalidData);
+    }
+    if(params & LP_SKIP_NORMALS)
+    {
+        removeComponents |= aiComponent_NORMALS | aiComponent_TANGENTS_AND_BITANGENTS;
+        flags &= ~(aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+    }
+    if(params & LP_SKIP_UVS)
+    {
+        removeComponents |= aiComponent_TEXCOORDS | aiComponent_TANGENTS_AND_BITANGENTS;
+        flags &= ~(aiProcess_GenUVCoords | aiProcess_TransformUVCoords | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    }
+    if(params & LP_SKIP_MATERIALS)
+    {
+        removeComponents |= aiComponent_MATERIALS | aiComponent_TEXTURES;
+        flags &= ~aiProcess_RemoveRedundantMaterials;
+    }
+
+    if(removeComponents)
+    {
+        removeComponents |= aiComponent_LIGHTS | aiComponent_CAMERAS;
+        flags |= aiProcess_RemoveComponent;
+    }
+
+    if(params & LP_PARALLEL_POSTPROCESS)
+    {
+        // done by MeshPostProcess, the steps Assimp runs after joining are applied afterwards
+        flags &= ~(aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices |
+                   aiProcess_ImproveCacheLocality | aiProcess_SplitLargeMeshes);
+    }
+
+    return flags;
+}
+
+bool AssimpLoader::matchesFilter(const char* name, const Ogre::String& filter, const std::regex& regex) const
+{
+    if(filter.empty())
+        return true;
+
+    if(mLoaderParams & LP_REGEX_FILTERS)
+        return std::regex_match(name, regex);
+
+    return Ogre::StringUtil::match(name, filter);
+}
+
+/// appends the quantised bind pose of a bone, q and -q are the same rotation
+static void appendBonePose(Ogre::String& identity, const Ogre::Vector3& pos, Ogre::Quaternion rot, const Ogre::Vector3& scale)
+{
+    auto append = [&identity](Ogre::Real v) {
+        Ogre::int32 q = Ogre::int32(Ogre::Math::Floor(v * 10000 + 0.5f));
+        identity.append(reinterpret_cast<const char*>(&q), sizeof(q));
+    };
+
+    if(rot.w < 0)
+        rot = -rot;
+    for(int c = 0; c < 3; ++c)
+        append(pos[c]);
+    append(rot.w); append(rot.x); append(rot.y); append(rot.z);
+    for(int c = 0; c < 3; ++c)
+        append(scale[c]);
+}
+
+/// quantised bone names, parents and bind pose in handle order
+static Ogre::String getBoneIdentity(const Ogre::Skeleton* skeleton)
+{
+    Ogre::String identity;
+    for(unsigned short i = 0; i < skeleton->getNumBones(); ++i)
+    {
+        const Ogre::Bone* bone = skeleton->getBone(i);
+        identity += bone->getName();
+        identity += '\0';
+        Ogre::uint16 parent = bone->getParent() ? static_cast<Ogre::Bone*>(bone->getParent())->getHandle() : 0xFFFF;
+        identity.append(reinterpret_cast<const char*>(&parent), sizeof(parent));
+        appendBonePose(identity, bone->getPosition(), bone->getOrientation(), bone->getScale());
+    }
+    return identity;
+}
+
+/// the name a clip gets in the skeleton, so selecting and splitting agree on it
+static Ogre::String getAnimationName(const aiAnimation* anim, int index, const Ogre::String& customName)
+{
+    Ogre::String animName;
+    if(customName != "")
+    {
+        animName = customName;
+        if(index >= 1)
+        {
+            animName += Ogre::StringConverter::toString(index);
+        }
+    }
+    else
+    {
+        animName = Ogre::String(anim->mName.data);
+    }
+    if(animName.length() < 1)
+    {
+        animName = "Animation" + Ogre::StringConverter::toString(index);
+    }
+    return animName;
+}
+
+static bool isAnimationSelected(const aiAnimation* anim, int index, const AssimpLoader::Options& options)
+{
+    return options.animations.empty() ||
+           std::find(options.animations.begin(), options.animations.end(),
+                     getAnimationName(anim, index, options.customAnimationName)) != options.animations.end();
+}
+
+/// hashes the keys of a channel field by field, the Assimp key structs are padded
+static Ogre::uint64 hashChannel(const aiNodeAnim* channel, Ogre::uint64 seed)
+{
+    Ogre::String keys(channel->mNodeName.data);
+    keys += '\0';
+    auto append = [&keys](const void* data, size_t size) { keys.append(static_cast<const char*>(data), size); };
+    append(&channel->mNumPositionKeys, sizeof(channel->mNumPositionKeys));
+    for(unsigned int k = 0; k < channel->mNumPositionKeys; ++k)
+    {
+        append(&channel->mPositionKeys[k].mTime, sizeof(double));
+        append(&channel->mPositionKeys[k].mValue, sizeof(aiVector3D));
+    }
+    append(&channel->mNumRotationKeys, sizeof(channel->mNumRotationKeys));
+    for(unsigned int k = 0; k < channel->mNumRotationKeys; ++k)
+    {
+        append(&channel->mRotationKeys[k].mTime, sizeof(double));
+        append(&channel->mRotationKeys[k].mValue, sizeof(aiQuaternion));
+    }
+    append(&channel->mNumScalingKeys, sizeof(channel->mNumScalingKeys));
+    for(unsigned int k = 0; k < channel->mNumScalingKeys; ++k)
+    {
+        append(&channel->mScalingKeys[k].mTime, sizeof(double));
+        append(&channel->mScalingKeys[k].mValue, sizeof(aiVector3D));
+    }
+    return MeshBlobSerializer::hash(keys.data(), keys.size(), seed);
+}
+
+/// the names findSharedSkeleton gives, "skeleton_" and 16 hex digits
+static bool isSharedSkeletonName(const Ogre::String& name)
+{
+    const Ogre::String prefix = "skeleton_", suffix = ".skeleton";
+    if(name.size() != prefix.size() + 16 + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+       name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+        return false;
+    return std::all_of(name.begin() + prefix.size(), name.end() - suffix.size(), [](char c) { return std::isxdigit(c) != 0; });
+}
+
+bool AssimpLoader::_loadAnimations(const char* name, Assimp::Importer& importer, const Ogre::SkeletonPtr& skeleton,
+                                   const Options& options)
+{
+    // a shared skeleton is named after its clips, other meshes link to it expecting just those
+    if(isSharedSkeletonName(skeleton->getName()))
+    {
+        Ogre::LogManager::getSingleton().logError("Not appending animations to the shared skeleton " + skeleton->getName());
+        return false;
+    }
+
+    // the clips need none of the post processing steps
+    mProgress = options.progress;
+    mCancelled = false;
+    const aiScene* scene = importer.ReadFile(name, 0);
+
+    if(!scene || mCancelled)
+    {
+        if(!mCancelled)
+            Ogre::LogManager::getSingleton().logError("Assimp failed - " + Ogre::String(importer.GetErrorString()));
+        importer.FreeScene();
+        mProgress = nullptr;
+        return false;
+    }
+
+    mAnimationSpeedModifier = options.animationSpeedModifier;
+    mLoaderParams = options.params;
+    mQuietMode = ((mLoaderParams & LP_QUIET_MODE) == 0) ? false : true;
+    mCustomAnimationName = options.customAnimationName;
+    mStats = Stats();
+    mSkeleton = skeleton;
+    mBoneNameMap = &options.boneNameMap;
+    mAppendingAnimations = true;
 
-    void write(const char* message)
+    size_t appended = 0;
+    for(unsigned int i = 0; i < scene->mNumAnimations; ++i)
     {
-        Ogre::String msg(message);
-        Ogre::StringUtil::trim(msg);
-        Ogre::LogManager::getSingleton().logMessage("Assimp: " + msg, _lml);
+        if(!reportProgress(PHASE_ANIMATIONS, float(i) / scene->mNumAnimations))
+            break;
+        if(!isAnimationSelected(scene->mAnimations[i], i, options))
+            continue;
+        parseAnimation(scene, i, scene->mAnimations[i]);
+        appended++;
     }
-};
-
-struct OgreIOSystem : public Assimp::MemoryIOSystem
-{
-    std::vector<Assimp::IOStream*> auxStreams;
-    Ogre::String _group;
+    const bool cancelled = mCancelled;
+    LogSink::getSingleton().flush();
 
-    OgreIOSystem(Ogre::MemoryDataStream& mainStream, const Ogre::String& group)
-        : Assimp::MemoryIOSystem(mainStream.getPtr(), mainStream.size(), NULL), _group(group)
+    if(!mQuietMode)
     {
+        Ogre::LogManager::getSingleton().logMessage(Ogre::StringUtil::format(
+            "Appended %zu animations to %s, %zu channels without a bone", appended, skeleton->getName().c_str(),
+            mStats.channelsSkipped));
     }
 
-    Assimp::IOStream* Open(const char* pFile, const char* pMode) override
+    importer.FreeScene();
+    clearLoadState();
+
+    return !cancelled;
+}
+
+bool AssimpLoader::_load(const char* name, Assimp::Importer& importer, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr,
+                         const Options& options, Ogre::uint64 sourceHash)
+{
+    // a malformed pattern fails the load before anything is imported
+    std::regex nodeRegex, meshRegex;
+    if(options.params & LP_REGEX_FILTERS)
     {
-        auto ret = Ogre::ResourceGroupManager::getSingleton().openResource(pFile, _group, NULL, false);
-        if (ret)
+        try
         {
-            Ogre::MemoryDataStream buffer(ret, false);
-            auxStreams.emplace_back(new Assimp::MemoryIOStream(buffer.getPtr(), buffer.size(), true));
-            return auxStreams.back();
+            nodeRegex.assign(options.nodeFilter);
+            meshRegex.assign(options.meshFilter);
         }
-        return Assimp::MemoryIOSystem::Open(pFile, pMode);
-    }
-    void Close(Assimp::IOStream* pFile) override
-    {
-        auto it = std::find(auxStreams.begin(), auxStreams.end(), pFile);
-        if (it != auxStreams.end())
+        catch(const std::regex_error& e)
         {
-            delete pFile;
-            auxStreams.erase(it);
+            Ogre::LogManager::getSingleton().logError("Invalid filter pattern for '" + mesh->getName() + "' - " + e.what());
+            return false;
         }
-        return Assimp::MemoryIOSystem::Close(pFile);
     }
-};
-
-int AssimpLoader::msBoneCount = 0;
-
-AssimpLoader::AssimpLoader()
-{
-    Assimp::DefaultLogger::create("");
-    Assimp::DefaultLogger::get()->attachStream(new OgreLogStream(Ogre::LML_NORMAL),
-                                               ~Assimp::DefaultLogger::Err);
-    Assimp::DefaultLogger::get()->attachStream(new OgreLogStream(Ogre::LML_CRITICAL),
-                                               Assimp::DefaultLogger::Err);
-}
-
-AssimpLoader::~AssimpLoader()
-{
-}
-
-bool AssimpLoader::load(const Ogre::DataStreamPtr& source, const Ogre::String& type, Ogre::Mesh* mesh,
-                        Ogre::SkeletonPtr& skeletonPtr, const Options& options)
-{
-    Assimp::Importer importer;
-    Ogre::MemoryDataStream buffer(source);
-    importer.SetIOHandler(new OgreIOSystem(buffer, mesh->getGroup()));
-    auto name = Ogre::StringUtil::format(AI_MEMORYIO_MAGIC_FILENAME ".%s", type.c_str());
-    _load(name.c_str(), importer, mesh, skeletonPtr, options);
-    return true;
-}
-
-bool AssimpLoader::load(const Ogre::String& source, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr,
-                        const AssimpLoader::Options& options)
-{
-    Assimp::Importer importer;
-    _load(source.c_str(), importer, mesh, skeletonPtr, options);
-    return true;
-}
 
-bool AssimpLoader::_load(const char* name, Assimp::Importer& importer, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr, const Options& options)
-{
-    Ogre::uint32 flags = aiProcessPreset_TargetRealtime_Quality | aiProcess_TransformUVCoords | aiProcess_FlipUVs;
+    int removeComponents;
+    Ogre::uint32 flags = getPostProcessFlags(options, removeComponents);
     importer.SetPropertyFloat("PP_GSN_MAX_SMOOTHING_ANGLE", options.maxEdgeAngle);
     importer.SetPropertyInteger("PP_SBP_REMOVE", aiPrimitiveType_LINE | aiPrimitiveType_POINT);
-    const aiScene* scene = importer.ReadFile(name, flags);
+    importer.SetPropertyInteger("PP_RVC_FLAGS", removeComponents);
+    mProgress = options.progress;
+    mCancelled = false;
+
+    // everything that changes the scene Assimp returns for the same source
+    SceneCache& cache = SceneCache::getSingleton();
+    std::shared_ptr<const aiScene> cached;
+    Ogre::uint64 cacheKey = 0;
+    if(sourceHash && cache.isEnabled() && !(options.params & LP_LOW_MEMORY))
+    {
+        Ogre::String settings = Ogre::StringUtil::format("%s|%u|%d|%g|%d", name, flags, removeComponents,
+                                                         options.maxEdgeAngle, (options.params & LP_PARALLEL_POSTPROCESS) != 0);
+        cacheKey = SceneCache::makeKey(sourceHash, settings.data(), settings.size());
+        Ogre::StringVector files;
+        cached = cache.find(cacheKey, &files);
+        for(const Ogre::String& file : files)
+            addDependency(mDependencies, file);
+    }
+
+    const aiScene* scene = cached ? cached.get() : importer.ReadFile(name, flags);
+
+    if(mCancelled)
+    {
+        importer.FreeScene();
+        mProgress = nullptr;
+        if(!(options.params & LP_QUIET_MODE))
+        {
+            Ogre::LogManager::getSingleton().logMessage("Import of '" + mesh->getName() + "' cancelled");
+        }
+        return false;
+    }
 
     // If the import failed, report it
     if( !scene)
@@ -139,11 +1343,72 @@ bool AssimpLoader::_load(const char* name, Assimp::Importer& importer, Ogre::Mes
         return false;
     }
 
+    if(!cached && (options.params & LP_PARALLEL_POSTPROCESS))
+    {
+        scene = postProcessInParallel(importer, options);
+        if(!scene)
+        {
+            Ogre::LogManager::getSingleton().logError("Assimp failed - " + Ogre::String(importer.GetErrorString()));
+            return false;
+        }
+    }
+
+    if(cached && !(options.params & LP_QUIET_MODE))
+    {
+        Ogre::LogManager::getSingleton().logMessage("Reusing cached scene of '" + mesh->getName() + "'");
+    }
+    else if(cacheKey)
+    {
+        // the cache owns the scene from now on, the importer is left empty
+        cached = cache.insert(cacheKey, importer.GetOrphanedScene(), mDependencies);
+        scene = cached.get();
+    }
+
+    // owning the scene lets us free the meshes one by one instead of all at once with the importer
+    std::unique_ptr<aiScene> ownedScene;
+    mMeshUseCount.clear();
+    if(options.params & LP_LOW_MEMORY)
+    {
+        ownedScene.reset(importer.GetOrphanedScene());
+        scene = ownedScene.get();
+        mMeshUseCount.resize(scene->mNumMeshes);
+        countMeshUses(scene->mRootNode, mMeshUseCount);
+    }
+
     mAnimationSpeedModifier = options.animationSpeedModifier;
     mLoaderParams = options.params;
     mQuietMode = ((mLoaderParams & LP_QUIET_MODE) == 0) ? false : true;
     mCustomAnimationName = options.customAnimationName;
+    mMaxBonesPerSubMesh = options.maxBonesPerSubMesh;
+    mTangentType = options.tangentType;
+    mChunkSize = options.chunkSize;
+    mChunks.clear();
+    mChunkByCell.clear();
+    mThreads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+#if OGRE_VERSION < ((1 << 16) | (12 << 8) | 0)
+    // packed 10 bit types arrived with Ogre 1.12
+    mTangentType = Ogre::VET_SHORT4_NORM;
+#endif
+    mNodeFilter = options.nodeFilter;
+    mMeshFilter = options.meshFilter;
+    if(mLoaderParams & LP_REGEX_FILTERS)
+    {
+        mNodeRegex.swap(nodeRegex);
+        mMeshRegex.swap(meshRegex);
+    }
+    // blend buffers hold 1, 2 or 4 weights, 3 is rounded down
+    mMaxBoneInfluences = options.maxBoneInfluences >= 4 ? 4 : (options.maxBoneInfluences >= 2 ? 2 : 1);
     mNodeDerivedTransformByName.clear();
+    mStats = Stats();
+    mSkeletonShared = false;
+    mSubMeshHashes.clear();
+    mBVH.clear();
+    mBoundingRadius = mesh->getBoundingSphereRadius();
+
+    // restored if the load is cancelled
+    const unsigned short numSubMeshes = mesh->getNumSubMeshes();
+    const Ogre::AxisAlignedBox bounds = mesh->getBounds();
+    const Ogre::Real radius = mesh->getBoundingSphereRadius();
 
     Ogre::String basename, extension;
     Ogre::StringUtil::splitBaseFilename(mesh->getName(), basename, extension);
@@ -153,32 +1418,138 @@ bool AssimpLoader::_load(const char* name, Assimp::Importer& importer, Ogre::Mes
 
     computeNodesDerivedTransform(scene, scene->mRootNode, scene->mRootNode->mTransformation);
 
-    if(mBonesByName.size())
+    if(mBonesByName.size() && (mLoaderParams & LP_PRUNE_UNUSED_BONES))
     {
-        mSkeleton = Ogre::SkeletonManager::getSingleton().create(basename+".skeleton", Ogre::RGN_DEFAULT, true);
+        pruneUnusedBones(scene);
+    }
 
-        msBoneCount = 0;
-        createBonesFromNode(scene, scene->mRootNode);
-        msBoneCount = 0;
-        createBoneHiearchy(scene, scene->mRootNode);
+    if(mBonesByName.size() && reportProgress(PHASE_SKELETON, 0))
+    {
+        // held until the clips are in, so a skeleton found by its shared name is complete
+        std::unique_lock<std::mutex> lock(msSkeletonMutex, std::defer_lock);
+        Ogre::String skeletonName;
+        if(mLoaderParams & LP_SHARE_SKELETONS)
+        {
+            lock.lock();
+            skeletonName = findSharedSkeleton(scene, options);
+        }
+        if(!mSkeleton)
+        {
+            createSkeleton(scene, skeletonName.empty() ? basename + ".skeleton" : skeletonName);
+        }
 
-        if(scene->HasAnimations())
+        // a shared skeleton already carries the clips, they are part of its name
+        if(!mSkeletonShared && scene->HasAnimations() && reportProgress(PHASE_SKELETON, 1))
         {
             for(unsigned int i = 0; i < scene->mNumAnimations; ++i)
             {
+                if(!reportProgress(PHASE_ANIMATIONS, float(i) / scene->mNumAnimations))
+                    break;
+                if(!isAnimationSelected(scene->mAnimations[i], i, options))
+                {
+                    continue;
+                }
                 parseAnimation(scene, i, scene->mAnimations[i]);
             }
+            reportProgress(PHASE_ANIMATIONS, 1);
+        }
+
+        // a skeleton cancelled halfway must not be shared
+        if(mCancelled && lock.owns_lock() && !mSkeletonShared)
+        {
+            Ogre::SkeletonManager::getSingleton().remove(mSkeleton->getHandle());
+            mSkeleton.reset();
+        }
+    }
+
+    if(!(mLoaderParams & LP_ANIMATIONS_ONLY) && !mCancelled)
+    {
+        loadMeshes(scene, mesh);
+    }
+
+    if(mCancelled)
+    {
+        cancelLoad(mesh, numSubMeshes, bounds, radius);
+        importer.FreeScene();
+        if(!mQuietMode)
+        {
+            Ogre::LogManager::getSingleton().logMessage("Import of '" + mesh->getName() + "' cancelled");
         }
+        return false;
     }
 
-    loadDataFromNode(scene, scene->mRootNode, mesh);
+    for (Chunk& chunk : mChunks)
+    {
+        chunk.mesh->_setBounds(chunk.bounds);
+        chunk.mesh->_setBoundingSphereRadius(chunk.radius);
+    }
 
-    Assimp::DefaultLogger::kill();
+    // the summary below follows the queued messages of the load
+    LogSink::getSingleton().flush();
 
-    if(mSkeleton)
+    if(!mQuietMode && mChunkSize > 0)
     {
+        if(mSkeleton)
+        {
+            Ogre::LogManager::getSingleton().logMessage("Not partitioning into chunks, the mesh is skinned");
+        }
+        else
+        {
+            Ogre::LogManager::getSingleton().logMessage("Partitioned static geometry into " + Ogre::StringConverter::toString(mChunks.size()) + " chunks");
+        }
+    }
 
+    if(mLoaderParams & LP_BUILD_BVH)
+    {
+        mBVH.build(mBVHTriangles);
         if(!mQuietMode)
+        {
+            Ogre::LogManager::getSingleton().logMessage("Built BVH with " + Ogre::StringConverter::toString(mBVH.getNodes().size()) + " nodes over " +
+                                                        Ogre::StringConverter::toString(mBVH.getTriangles().size()) + " triangles");
+        }
+    }
+
+    if(!mQuietMode && mStats.blendBytesBefore)
+    {
+        Ogre::LogManager::getSingleton().logMessage("Blend weights take " + Ogre::StringConverter::toString(mStats.blendBytesAfter) + " bytes, " +
+                                                    Ogre::StringConverter::toString(mStats.blendBytesBefore) + " bytes before limiting to " +
+                                                    Ogre::StringConverter::toString(mMaxBoneInfluences) + " influences" +
+                                                    ((mLoaderParams & LP_QUANTISE_BONE_WEIGHTS) ? " and quantising (in memory only)" : ""));
+    }
+
+    if(!mQuietMode && mStats.paletteSplits)
+    {
+        Ogre::LogManager::getSingleton().logMessage("Bone palette limit of " + Ogre::StringConverter::toString(mMaxBonesPerSubMesh) + " added " +
+                                                    Ogre::StringConverter::toString(mStats.paletteSplits) + " draw calls");
+    }
+
+    if(!mQuietMode && mStats.meshBytesReleased)
+    {
+        Ogre::LogManager::getSingleton().logMessage("Released " + Ogre::StringConverter::toString(mStats.meshBytesReleased) +
+                                                    " bytes of Assimp mesh data during the conversion");
+    }
+
+    if(!mQuietMode && mStats.splitMeshes)
+    {
+        Ogre::LogManager::getSingleton().logMessage("Split " + Ogre::StringConverter::toString(mStats.splitMeshes) + " meshes into " +
+                                                    Ogre::StringConverter::toString(mStats.splitSubMeshes) + " 16 bit submeshes, saving " +
+                                                    Ogre::StringConverter::toString(mStats.indexBytesSaved) + " index bytes");
+    }
+
+    if(!mQuietMode)
+    {
+        Ogre::LogManager::getSingleton().logMessage("Node, bone and keyframe lookups made " + Ogre::StringConverter::toString(mArena.getAllocations()) +
+                                                    " allocations, served by " + Ogre::StringConverter::toString(mArena.getHeapAllocations()) +
+                                                    " heap allocations (" + Ogre::StringConverter::toString(mArena.getBytes()) + " bytes)");
+    }
+
+    // the importer is reused by the next load on this thread
+    importer.FreeScene();
+
+    if(mSkeleton)
+    {
+
+        if(!mQuietMode && !mSkeleton->getRootBones().empty())
         {
             Ogre::LogManager::getSingleton().logMessage("Root bone: " + mSkeleton->getRootBones()[0]->getName());
         }
@@ -195,35 +1566,187 @@ bool AssimpLoader::_load(const char* name, Assimp::Importer& importer, Ogre::Mes
         mesh->setSkeletonName(mSkeleton->getName());
     }
 
-    for (auto sm : mesh->getSubMeshes())
+    // the hashes only describe the mesh if this load created all of its submeshes
+    if(numSubMeshes == 0)
+        mesh->getUserObjectBindings().setUserAny(SUBMESH_HASHES, Ogre::Any(mSubMeshHashes));
+    else
+        mesh->getUserObjectBindings().eraseUserAny(SUBMESH_HASHES);
+
+    clearLoadState();
+
+    return true;
+}
+
+void AssimpLoader::createSkeleton(const aiScene* mScene, const Ogre::String& name)
+{
+    mSkeleton = Ogre::SkeletonManager::getSingleton().create(name, Ogre::RGN_DEFAULT, true);
+
+    mBoneCount = 0;
+    createBonesFromNode(mScene, mScene->mRootNode);
+    mBoneCount = 0;
+    createBoneHiearchy(mScene, mScene->mRootNode);
+}
+
+Ogre::uint64 AssimpLoader::hashSkeleton(const Ogre::Skeleton* skeleton)
+{
+    Ogre::String identity = getBoneIdentity(skeleton);
+    return MeshBlobSerializer::hash(identity.data(), identity.size());
+}
+
+void AssimpLoader::appendBoneIdentity(const aiNode* pNode, std::map<Ogre::String, Ogre::uint16>& handles, Ogre::String& identity)
+{
+    if(isNodeNeeded(pNode->mName.data))
     {
-        if (!sm->useSharedVertices)
+        // the handles, parents and bind pose createBonesFromNode and createBoneHiearchy would produce
+        aiMatrix4x4 aiM = pNode->mTransformation;
+        const aiNode* parentNode = pNode->mParent;
+        while(parentNode && mPrunedBones.count(parentNode->mName.data))
+        {
+            aiM = parentNode->mTransformation * aiM;
+            parentNode = parentNode->mParent;
+        }
+        auto parent = parentNode ? handles.find(parentNode->mName.data) : handles.end();
+        Ogre::uint16 parentHandle = parent != handles.end() ? parent->second : 0xFFFF;
+        Ogre::uint16 handle = Ogre::uint16(handles.size());
+        handles[pNode->mName.data] = handle;
+
+        Ogre::Vector3 pos = Ogre::Vector3::ZERO;
+        Ogre::Quaternion rot = Ogre::Quaternion::IDENTITY;
+        if(!aiM.IsIdentity())
         {
+            aiQuaternion q;
+            aiVector3D p, scale;
+            aiM.Decompose(scale, q, p);
+            pos = Ogre::Vector3(p.x, p.y, p.z);
+            // Node::setOrientation normalises as well
+            rot = Ogre::Quaternion(q.w, q.x, q.y, q.z);
+            rot.normalise();
+        }
+
+        identity += pNode->mName.data;
+        identity += '\0';
+        identity.append(reinterpret_cast<const char*>(&parentHandle), sizeof(parentHandle));
+        appendBonePose(identity, pos, rot, Ogre::Vector3::UNIT_SCALE);
+    }
+    for(unsigned int childIdx = 0; childIdx < pNode->mNumChildren; ++childIdx)
+    {
+        appendBoneIdentity(pNode->mChildren[childIdx], handles, identity);
+    }
+}
 
-            Ogre::VertexDeclaration* newDcl =
-                sm->vertexData->vertexDeclaration->getAutoOrganisedDeclaration(mesh->hasSkeleton(), mesh->hasVertexAnimation(), false);
+Ogre::String AssimpLoader::findSharedSkeleton(const aiScene* mScene, const Options& options)
+{
+    // hashed straight from the nodes, the skeleton itself is only built when nothing matches
+    std::map<Ogre::String, Ogre::uint16> handles;
+    Ogre::String bones;
+    appendBoneIdentity(mScene->mRootNode, handles, bones);
+
+    // the clips and the options shaping them are part of the name, so the skeleton behind a name
+    // never changes its animations
+    Ogre::String identity = bones;
+    identity += Ogre::StringConverter::toString(options.animationSpeedModifier) + '\0' +
+                Ogre::StringConverter::toString(bool(options.params & LP_CUT_ANIMATION_WHERE_NO_FURTHER_CHANGE)) + '\0';
+    Ogre::uint64 keysHash = 0xcbf29ce484222325ULL;
+    for(unsigned int i = 0; i < mScene->mNumAnimations; ++i)
+    {
+        const aiAnimation* anim = mScene->mAnimations[i];
+        if(isAnimationSelected(anim, i, options))
+        {
+            identity += getAnimationName(anim, i, options.customAnimationName) + '\0' + Ogre::StringConverter::toString(Ogre::Real(anim->mDuration)) + '\0' +
+                        Ogre::StringConverter::toString(Ogre::Real(anim->mTicksPerSecond)) + '\0' +
+                        Ogre::StringConverter::toString(anim->mNumChannels) + '\0';
+            for(unsigned int c = 0; c < anim->mNumChannels; ++c)
+            {
+                keysHash = hashChannel(anim->mChannels[c], keysHash);
+            }
+        }
+    }
+    Ogre::String name = Ogre::StringUtil::format("skeleton_%016llx.skeleton",
+                                                 (unsigned long long)MeshBlobSerializer::hash(identity.data(), identity.size(), keysHash));
 
-            if (*newDcl != *(sm->vertexData->vertexDeclaration))
+    Ogre::SkeletonPtr shared = Ogre::SkeletonManager::getSingleton().getByName(name, Ogre::RGN_DEFAULT);
+    if(shared)
+    {
+        if(getBoneIdentity(shared.get()) == bones)
+        {
+            mSkeleton = shared;
+            mSkeletonShared = true;
+            if(!mQuietMode)
             {
-                sm->vertexData->reorganiseBuffers(newDcl);
+                Ogre::LogManager::getSingleton().logMessage("Sharing skeleton " + name);
             }
         }
+        else
+        {
+            Ogre::LogManager::getSingleton().logWarning("Skeleton hash collision on " + name + ", not sharing");
+            name.clear();
+        }
     }
+    return name;
+}
+
+bool AssimpLoader::reportProgress(LoadPhase phase, float progress)
+{
+    if(!mCancelled && mProgress && !mProgress(phase, progress))
+    {
+        mCancelled = true;
+    }
+    return !mCancelled;
+}
+
+void AssimpLoader::cancelLoad(Ogre::Mesh* mesh, unsigned short numSubMeshes, const Ogre::AxisAlignedBox& bounds, Ogre::Real radius)
+{
+    while(mesh->getNumSubMeshes() > numSubMeshes)
+    {
+        mesh->destroySubMesh(mesh->getNumSubMeshes() - 1);
+    }
+    mesh->_setBounds(bounds, false);
+    mesh->_setBoundingSphereRadius(radius);
+
+    // nothing references them yet, materials stay as other meshes may share them
+    if(mSkeleton && !mSkeletonShared)
+    {
+        Ogre::SkeletonManager::getSingleton().remove(mSkeleton->getHandle());
+    }
+    for (Chunk& chunk : mChunks)
+    {
+        Ogre::MeshManager::getSingleton().remove(chunk.mesh->getHandle());
+    }
+    mChunks.clear();
+    mChunkByCell.clear();
+    mBVH.clear();
+    mBVHTriangles.clear();
+    mMeshUseCount.clear();
+    mStats = Stats();
+
+    clearLoadState();
+}
 
-    // clean up
+void AssimpLoader::clearLoadState()
+{
+    mStats.transientAllocations = mArena.getAllocations();
+    mStats.transientHeapAllocations = mArena.getHeapAllocations();
+
+    // the maps point into the arena, so they go first
     mBonesByName.clear();
     mBoneNodesByName.clear();
     boneMap.clear();
+    mPrunedBones.clear();
+    mFoldedTransformByName.clear();
+    mNodeDerivedTransformByName.clear();
+    mArena.reset();
+
     mSkeleton.reset();
+    mProgress = nullptr;
+    mBoneNameMap = NULL;
+    mAppendingAnimations = false;
 
     mCustomAnimationName = "";
-
-    return true;
 }
 
 /** translation, rotation, scale */
 typedef std::tuple< aiVectorKey*, aiQuatKey*, aiVectorKey* > KeyframeData;
-typedef std::map< Ogre::Real, KeyframeData > KeyframesMap;
+typedef ArenaMap< Ogre::Real, KeyframeData > KeyframesMap;
 
 template <int v>
 struct Int2Type
@@ -410,31 +1933,19 @@ void AssimpLoader::parseAnimation (const aiScene* mScene, int index, aiAnimation
     // To get PoseToKey which is what Ogre needs we'ed have to build the transform from components in
     // aiNodeAnim and then DefBonePose.Inverse() * aiNodeAnim(generated transform) will be the right transform
 
-    Ogre::String animName;
-    if(mCustomAnimationName != "")
-    {
-        animName = mCustomAnimationName;
-        if(index >= 1)
-        {
-            animName += Ogre::StringConverter::toString(index);
-        }
-    }
-    else
+    Ogre::String animName = getAnimationName(anim, index, mCustomAnimationName);
+
+    if(!mQuietMode)
     {
-        animName = Ogre::String(anim->mName.data);
+        LOGSINK_LOG(LogSink::LEVEL_DETAIL, "animation", "Animation name = '%s', duration = %g, tick/sec = %g, channels = %u",
+                    animName.c_str(), anim->mDuration, anim->mTicksPerSecond, anim->mNumChannels);
     }
-    if(animName.length() < 1)
+    // appending to an existing skeleton replaces a clip of the same name
+    if(mAppendingAnimations && mSkeleton->hasAnimation(animName))
     {
-        animName = "Animation" + Ogre::StringConverter::toString(index);
+        mSkeleton->removeAnimation(animName);
     }
 
-    if(!mQuietMode)
-    {
-        Ogre::LogManager::getSingleton().logMessage("Animation name = '" + animName + "'");
-        Ogre::LogManager::getSingleton().logMessage("duration = " + Ogre::StringConverter::toString(Ogre::Real(anim->mDuration)));
-        Ogre::LogManager::getSingleton().logMessage("tick/sec = " + Ogre::StringConverter::toString(Ogre::Real(anim->mTicksPerSecond)));
-        Ogre::LogManager::getSingleton().logMessage("channels = " + Ogre::StringConverter::toString(anim->mNumChannels));
-    }
     Ogre::Animation* animation;
     mTicksPerSecond = (Ogre::Real)((0 == anim->mTicksPerSecond) ? 24 : anim->mTicksPerSecond);
     mTicksPerSecond *= mAnimationSpeedModifier;
@@ -484,7 +1995,7 @@ void AssimpLoader::parseAnimation (const aiScene* mScene, int index, aiAnimation
 
     if(!mQuietMode)
     {
-        Ogre::LogManager::getSingleton().logMessage("Cut Time " + Ogre::StringConverter::toString(cutTime));
+        LOGSINK_LOG(LogSink::LEVEL_DETAIL, "animation", "Cut Time %g", double(cutTime));
     }
 
     for (int i = 0; i < (int)anim->mNumChannels; i++)
@@ -494,25 +2005,48 @@ void AssimpLoader::parseAnimation (const aiScene* mScene, int index, aiAnimation
         aiNodeAnim* node_anim = anim->mChannels[i];
         if(!mQuietMode)
         {
-            Ogre::LogManager::getSingleton().logMessage("Channel " + Ogre::StringConverter::toString(i));
-            Ogre::LogManager::getSingleton().logMessage("affecting node: " + Ogre::String(node_anim->mNodeName.data));
+            LOGSINK_LOG(LogSink::LEVEL_TRACE, "channel", "Channel %d affecting node: %s", i, node_anim->mNodeName.data);
             //Ogre::LogManager::getSingleton().logMessage("position keys: " + Ogre::StringConverter::toString(node_anim->mNumPositionKeys));
             //Ogre::LogManager::getSingleton().logMessage("rotation keys: " + Ogre::StringConverter::toString(node_anim->mNumRotationKeys));
             //Ogre::LogManager::getSingleton().logMessage("scaling keys: " + Ogre::StringConverter::toString(node_anim->mNumScalingKeys));
         }
 
         Ogre::String boneName = Ogre::String(node_anim->mNodeName.data);
+        if(mBoneNameMap)
+        {
+            std::map<Ogre::String, Ogre::String>::const_iterator renamed = mBoneNameMap->find(boneName);
+            if(renamed != mBoneNameMap->end())
+                boneName = renamed->second;
+        }
 
-        if(mSkeleton->hasBone(boneName))
+        // Animation::apply looks the bones up by track handle, a second channel of a bone is dropped
+        if(!mSkeleton->hasBone(boneName) || animation->hasNodeTrack(mSkeleton->getBone(boneName)->getHandle()))
+        {
+            mStats.channelsSkipped++;
+        }
+        else
         {
             Ogre::Bone* bone = mSkeleton->getBone(boneName);
             Affine3 defBonePoseInv;
             defBonePoseInv.makeInverseTransform(bone->getPosition(), bone->getScale(), bone->getOrientation());
 
-            Ogre::NodeAnimationTrack* track = animation->createNodeTrack(i, bone);
+            Ogre::NodeAnimationTrack* track = animation->createNodeTrack(bone->getHandle(), bone);
+
+            // keys are relative to the original parent, move them past any pruned bones
+            Affine3 foldedTransform = Affine3::IDENTITY;
+            NodeTransformMap::iterator folded = mFoldedTransformByName.find(boneName.c_str());
+            if(folded != mFoldedTransformByName.end())
+            {
+                aiVector3D foldedPos, foldedScale;
+                aiQuaternion foldedRot;
+                folded->second.Decompose(foldedScale, foldedRot, foldedPos);
+                foldedTransform.makeTransform(Ogre::Vector3(foldedPos.x, foldedPos.y, foldedPos.z),
+                                              Ogre::Vector3(foldedScale.x, foldedScale.y, foldedScale.z),
+                                              Ogre::Quaternion(foldedRot.w, foldedRot.x, foldedRot.y, foldedRot.z));
+            }
 
             // Ogre needs translate rotate and scale for each keyframe in the track
-            KeyframesMap keyframes;
+            KeyframesMap keyframes(mArena);
 
             for(unsigned int i = 0; i < node_anim->mNumPositionKeys; i++)
             {
@@ -558,40 +2092,114 @@ void AssimpLoader::parseAnimation (const aiScene* mScene, int index, aiAnimation
                     aiQuaternion aiRot = getRotate(node_anim, keyframes, it, mTicksPerSecond);
                     Ogre::Quaternion rot(aiRot.w, aiRot.x, aiRot.y, aiRot.z);
 
-                    aiVector3D aiScale = getScale(node_anim, keyframes, it, mTicksPerSecond);
-                    Ogre::Vector3 scale(aiScale.x, aiScale.y, aiScale.z);
-                    
-                    Ogre::Vector3 transCopy = trans;
+                    aiVector3D aiScale = getScale(node_anim, keyframes, it, mTicksPerSecond);
+                    Ogre::Vector3 scale(aiScale.x, aiScale.y, aiScale.z);
+                    
+                    Ogre::Vector3 transCopy = foldedTransform * trans;
+
+                    Affine3 fullTransform;
+                    fullTransform.makeTransform(trans, scale, rot);
+                    fullTransform = foldedTransform * fullTransform;
+
+                    Affine3 poseTokey = defBonePoseInv * fullTransform;
+                    poseTokey.decomposition(trans, scale, rot);
+
+                    keyframe = track->createNodeKeyFrame(Ogre::Real(it->first));
+
+                    // weirdness with the root bone, But this seems to work
+                    if(mSkeleton->getRootBones()[0]->getName() == boneName)
+                    {
+                        trans = transCopy - bone->getPosition();
+                    }
+
+                    keyframe->setTranslate(trans);
+                    keyframe->setRotation(rot);
+                    keyframe->setScale(scale);
+                }
+            }
+
+        } // if bone exists
+
+    } // loop through channels
+
+    // the clips already on an existing skeleton were optimised when they were loaded
+    if(mAppendingAnimations)
+        animation->optimise();
+    else
+        mSkeleton->optimiseAllAnimations();
+}
+
+
+
+Ogre::String ReplaceSpaces(const Ogre::String& s)
+{
+    Ogre::String res(s);
+    replace(res.begin(), res.end(), ' ', '_');
+
+    return res;
+}
+
+void AssimpLoader::splitAnimations(const Ogre::SkeletonPtr& skeleton, const AnimationGroups& groups,
+                                   std::vector<Ogre::SkeletonPtr>& animationSkeletons)
+{
+    AnimationGroups allGroups = groups;
+
+    std::set<Ogre::String> grouped;
+    for(AnimationGroups::const_iterator it = groups.begin(); it != groups.end(); ++it)
+    {
+        grouped.insert(it->second.begin(), it->second.end());
+    }
+    for(unsigned short i = 0; i < skeleton->getNumAnimations(); ++i)
+    {
+        const Ogre::String& animName = skeleton->getAnimation(i)->getName();
+        if(!grouped.count(animName))
+        {
+            allGroups[animName].push_back(animName);
+        }
+    }
+
+    Ogre::String basename, extension;
+    Ogre::StringUtil::splitBaseFilename(skeleton->getName(), basename, extension);
 
-                    Affine3 fullTransform;
-                    fullTransform.makeTransform(trans, scale, rot);
+    for(AnimationGroups::const_iterator it = allGroups.begin(); it != allGroups.end(); ++it)
+    {
+        Ogre::SkeletonPtr target = Ogre::SkeletonManager::getSingleton().create(basename + "_" + ReplaceSpaces(it->first) + ".skeleton",
+                                                                               skeleton->getGroup(), true);
 
-                    Affine3 poseTokey = defBonePoseInv * fullTransform;
-                    poseTokey.decomposition(trans, scale, rot);
+        copyBones(skeleton.get(), target.get());
 
-                    keyframe = track->createNodeKeyFrame(Ogre::Real(it->first));
+        for(const Ogre::String& animName : it->second)
+        {
+            if(!skeleton->hasAnimation(animName))
+                continue;
 
-                    // weirdness with the root bone, But this seems to work
-                    if(mSkeleton->getRootBones()[0]->getName() == boneName)
-                    {
-                        trans = transCopy - bone->getPosition();
-                    }
+            Ogre::Animation* src = skeleton->getAnimation(animName);
+            Ogre::Animation* dst = target->createAnimation(animName, src->getLength());
+            dst->setInterpolationMode(src->getInterpolationMode());
 
-                    keyframe->setTranslate(trans);
-                    keyframe->setRotation(rot);
-                    keyframe->setScale(scale);
+            const Ogre::Animation::NodeTrackList& tracks = src->_getNodeTrackList();
+            for(Ogre::Animation::NodeTrackList::const_iterator t = tracks.begin(); t != tracks.end(); ++t)
+            {
+                // the bone the track drives, its handle is the same in target
+                unsigned short handle = static_cast<Ogre::Bone*>(t->second->getAssociatedNode())->getHandle();
+                Ogre::NodeAnimationTrack* dstTrack = dst->createNodeTrack(handle, target->getBone(handle));
+                for(unsigned short k = 0; k < t->second->getNumKeyFrames(); ++k)
+                {
+                    Ogre::TransformKeyFrame* srcKey = t->second->getNodeKeyFrame(k);
+                    Ogre::TransformKeyFrame* dstKey = dstTrack->createNodeKeyFrame(srcKey->getTime());
+                    dstKey->setTranslate(srcKey->getTranslate());
+                    dstKey->setRotation(srcKey->getRotation());
+                    dstKey->setScale(srcKey->getScale());
                 }
             }
 
-        } // if bone exists
-
-    } // loop through channels
+            skeleton->removeAnimation(animName);
+        }
 
-    mSkeleton->optimiseAllAnimations();
+        animationSkeletons.push_back(target);
+    }
 }
 
-
-
 void AssimpLoader::markAllChildNodesAsNeeded(const aiNode *pNode)
 {
     flagNodeAsNeeded(pNode->mName.data);
@@ -603,13 +2211,67 @@ void AssimpLoader::markAllChildNodesAsNeeded(const aiNode *pNode)
     }
 }
 
+void AssimpLoader::pruneUnusedBones(const aiScene* mScene)
+{
+    // a bone is used if it carries vertex weights or is driven by an animation channel
+    // names in the scene, it outlives the set
+    std::set<const char*, CStringLess> usedBones;
+    for(unsigned int m = 0; m < mScene->mNumMeshes; ++m)
+    {
+        const aiMesh* pAIMesh = mScene->mMeshes[m];
+        for(unsigned int b = 0; b < pAIMesh->mNumBones; ++b)
+        {
+            if(pAIMesh->mBones[b]->mNumWeights > 0)
+                usedBones.insert(pAIMesh->mBones[b]->mName.data);
+        }
+    }
+    for(unsigned int a = 0; a < mScene->mNumAnimations; ++a)
+    {
+        const aiAnimation* anim = mScene->mAnimations[a];
+        for(unsigned int c = 0; c < anim->mNumChannels; ++c)
+        {
+            usedBones.insert(anim->mChannels[c]->mNodeName.data);
+        }
+    }
+
+    size_t keptBones = 0;
+    for(boneMapType::iterator it = boneMap.begin(); it != boneMap.end(); ++it)
+    {
+        if(!it->second)
+            continue;
+
+        if(usedBones.count(it->first))
+        {
+            keptBones++;
+            continue;
+        }
+
+        it->second = false;
+        mPrunedBones.insert(it->first);
+    }
+
+    mStats.bonesPruned = mPrunedBones.size();
+
+    // a rigged but unskinned prop, nothing needs a skeleton
+    if(!keptBones)
+    {
+        mBonesByName.clear();
+    }
+
+    if(!mQuietMode)
+    {
+        Ogre::LogManager::getSingleton().logMessage("Pruned " + Ogre::StringConverter::toString(mPrunedBones.size()) + " unused bones, " +
+                                                    Ogre::StringConverter::toString(keptBones) + " bones remain");
+    }
+}
+
 void AssimpLoader::grabNodeNamesFromNode(const aiScene* mScene, const aiNode* pNode)
 {
-    boneMap.emplace(Ogre::String(pNode->mName.data), false);
-    mBoneNodesByName[pNode->mName.data] = pNode;
+    arenaEntry(boneMap, pNode->mName.data);
+    arenaEntry(mBoneNodesByName, pNode->mName.data) = pNode;
     if(!mQuietMode)
     {
-        Ogre::LogManager::getSingleton().logMessage("Node " + Ogre::String(pNode->mName.data) + " found.");
+        LOGSINK_LOG(LogSink::LEVEL_TRACE, "node", "Node %s found.", pNode->mName.data);
     }
 
     // Traverse all child nodes of the current node instance
@@ -625,7 +2287,7 @@ void AssimpLoader::computeNodesDerivedTransform(const aiScene* mScene,  const ai
 {
     if(mNodeDerivedTransformByName.find(pNode->mName.data) == mNodeDerivedTransformByName.end())
     {
-        mNodeDerivedTransformByName[pNode->mName.data] = accTransform;
+        arenaEntry(mNodeDerivedTransformByName, pNode->mName.data) = accTransform;
     }
     for ( unsigned int childIdx=0; childIdx<pNode->mNumChildren; ++childIdx )
     {
@@ -638,7 +2300,7 @@ void AssimpLoader::createBonesFromNode(const aiScene* mScene,  const aiNode *pNo
 {
     if(isNodeNeeded(pNode->mName.data))
     {
-        Ogre::Bone* bone = mSkeleton->createBone(Ogre::String(pNode->mName.data), msBoneCount);
+        Ogre::Bone* bone = mSkeleton->createBone(Ogre::String(pNode->mName.data), mBoneCount);
 
         aiQuaternion rot;
         aiVector3D pos;
@@ -665,6 +2327,23 @@ void AssimpLoader::createBonesFromNode(const aiScene* mScene,  const aiNode *pNo
         // above should be the same as
         aiMatrix4x4 aiM = pNode->mTransformation;
 
+        // fold in the transforms of pruned ancestors up to the parent bone
+        if(!mPrunedBones.empty())
+        {
+            aiMatrix4x4 folded;
+            const aiNode* parentNode = pNode->mParent;
+            while(parentNode && mPrunedBones.count(parentNode->mName.data))
+            {
+                folded = parentNode->mTransformation * folded;
+                parentNode = parentNode->mParent;
+            }
+            if(!folded.IsIdentity())
+            {
+                arenaEntry(mFoldedTransformByName, pNode->mName.data) = folded;
+                aiM = folded * aiM;
+            }
+        }
+
         aiM.Decompose(scale, rot, pos);
 
 
@@ -700,9 +2379,9 @@ void AssimpLoader::createBonesFromNode(const aiScene* mScene,  const aiNode *pNo
 
         if(!mQuietMode)
         {
-            Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(msBoneCount) + ") Creating bone '" + Ogre::String(pNode->mName.data) + "'");
+            LOGSINK_LOG(LogSink::LEVEL_TRACE, "bone", "%d) Creating bone '%s'", mBoneCount, pNode->mName.data);
         }
-        msBoneCount++;
+        mBoneCount++;
     }
     // Traverse all child nodes of the current node instance
     for ( unsigned int childIdx=0; childIdx<pNode->mNumChildren; ++childIdx )
@@ -718,11 +2397,18 @@ void AssimpLoader::createBoneHiearchy(const aiScene* mScene,  const aiNode *pNod
     {
         Ogre::Bone* parent = 0;
         Ogre::Bone* child = 0;
-        if(pNode->mParent)
+
+        // pruned bones are skipped, their children attach to the next bone up
+        const aiNode* parentNode = pNode->mParent;
+        while(parentNode && mPrunedBones.count(parentNode->mName.data))
+        {
+            parentNode = parentNode->mParent;
+        }
+        if(parentNode)
         {
-            if(mSkeleton->hasBone(pNode->mParent->mName.data))
+            if(mSkeleton->hasBone(parentNode->mName.data))
             {
-                parent = mSkeleton->getBone(pNode->mParent->mName.data);
+                parent = mSkeleton->getBone(parentNode->mName.data);
             }
         }
         if(mSkeleton->hasBone(pNode->mName.data))
@@ -744,7 +2430,7 @@ void AssimpLoader::createBoneHiearchy(const aiScene* mScene,  const aiNode *pNod
 
 void AssimpLoader::flagNodeAsNeeded(const char* name)
 {
-    boneMapType::iterator iter = boneMap.find(Ogre::String(name));
+    boneMapType::iterator iter = boneMap.find(name);
     if( iter != boneMap.end())
     {
         iter->second = true;
@@ -753,7 +2439,7 @@ void AssimpLoader::flagNodeAsNeeded(const char* name)
 
 bool AssimpLoader::isNodeNeeded(const char* name)
 {
-    boneMapType::iterator iter = boneMap.find(Ogre::String(name));
+    boneMapType::iterator iter = boneMap.find(name);
     if( iter != boneMap.end())
     {
         return iter->second;
@@ -778,11 +2464,11 @@ void AssimpLoader::grabBoneNamesFromNode(const aiScene* mScene,  const aiNode *p
                     aiBone *pAIBone = pAIMesh->mBones[ i ];
                     if ( NULL != pAIBone )
                     {
-                        mBonesByName[pAIBone->mName.data] = pAIBone;
+                        arenaEntry(mBonesByName, pAIBone->mName.data) = pAIBone;
 
                         if(!mQuietMode)
                         {
-                            Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(i) + ") REAL BONE with name : " + Ogre::String(pAIBone->mName.data));
+                            LOGSINK_LOG(LogSink::LEVEL_TRACE, "bone", "%u) REAL BONE with name : %s", unsigned(i), pAIBone->mName.data);
                         }
 
                         // flag this node and all parents of this node as needed, until we reach the node holding the mesh, or the parent.
@@ -823,14 +2509,6 @@ void AssimpLoader::grabBoneNamesFromNode(const aiScene* mScene,  const aiNode *p
     }
 }
 
-Ogre::String ReplaceSpaces(const Ogre::String& s)
-{
-    Ogre::String res(s);
-    replace(res.begin(), res.end(), ' ', '_');
-
-    return res;
-}
-
 Ogre::MaterialPtr AssimpLoader::createMaterial(int index, const aiMaterial* mat)
 {
     static int dummyMatCount = 0;
@@ -853,14 +2531,14 @@ Ogre::MaterialPtr AssimpLoader::createMaterial(int index, const aiMaterial* mat)
     {
         if(!mQuietMode)
         {
-            Ogre::LogManager::getSingleton().logMessage("Using aiGetMaterialString : Name " + Ogre::String(szPath.data));
+            LOGSINK_LOG(LogSink::LEVEL_DETAIL, "material", "Using aiGetMaterialString : Name %s", szPath.data);
         }
     }
     if(szPath.length < 1)
     {
         if(!mQuietMode)
         {
-            Ogre::LogManager::getSingleton().logMessage("Unnamed material encountered...");
+            LOGSINK_LOG(LogSink::LEVEL_DETAIL, "material", "Unnamed material encountered...");
         }
         szPath = Ogre::String("dummyMat" + Ogre::StringConverter::toString(dummyMatCount)).c_str();
         dummyMatCount++;
@@ -868,14 +2546,24 @@ Ogre::MaterialPtr AssimpLoader::createMaterial(int index, const aiMaterial* mat)
 
     if(!mQuietMode)
     {
-        Ogre::LogManager::getSingleton().logMessage("Creating " + Ogre::String(szPath.data));
+        LOGSINK_LOG(LogSink::LEVEL_DETAIL, "material", "Creating %s", szPath.data);
     }
 
     Ogre::ResourceManager::ResourceCreateOrRetrieveResult status = omatMgr->createOrRetrieve(ReplaceSpaces(szPath.data), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
     Ogre::MaterialPtr omat = Ogre::static_pointer_cast<Ogre::Material>(status.first);
 
+    Ogre::MaterialPtr existing;
     if (!status.second)
-        return omat;
+    {
+        if (!mUpdateMaterials || mUpdatedMaterials.count(omat->getName()))
+            return omat;
+
+        // reimport, the parameters go to a scratch material until the load succeeds
+        static std::atomic<unsigned int> count(0);
+        existing = omat;
+        omat = omatMgr->create("reimport" + Ogre::StringConverter::toString(count++) + "_" + existing->getName(), existing->getGroup());
+        mUpdatedMaterials[existing->getName()] = omat;
+    }
 
     // ambient
     aiColor4D clr(1.0f, 1.0f, 1.0f, 1.0);
@@ -930,106 +2618,620 @@ Ogre::MaterialPtr AssimpLoader::createMaterial(int index, const aiMaterial* mat)
     {
         if(!mQuietMode)
         {
-            Ogre::LogManager::getSingleton().logMessage("Found texture " + Ogre::String(path.data) + " for channel " + Ogre::StringConverter::toString(uvindex));
+            LOGSINK_LOG(LogSink::LEVEL_DETAIL, "material", "Found texture %s for channel %u", path.data, unsigned(uvindex));
+        }
+        if(AI_SUCCESS == aiGetMaterialString(mat, AI_MATKEY_TEXTURE_DIFFUSE(0), &szPath))
+        {
+            if(!mQuietMode)
+            {
+                LOGSINK_LOG(LogSink::LEVEL_DETAIL, "material", "Using aiGetMaterialString : Found texture %s for channel %u", szPath.data,
+                            unsigned(uvindex));
+            }
+        }
+
+        Ogre::String basename;
+        Ogre::String outPath;
+        Ogre::StringUtil::splitFilename(Ogre::String(szPath.data), basename, outPath);
+        omat->getTechnique(0)->getPass(0)->createTextureUnitState(basename);
+
+        // textures are resolved relative to the source file, embedded ones are named *<index>
+        if(path.data[0] != '*')
+        {
+            // splitFilename turned backslashes into slashes
+            bool absolute = !outPath.empty() && (outPath[0] == '/' || (outPath.size() > 1 && outPath[1] == ':'));
+            if(mSourceDir.empty())
+                addDependency(mDependencies, basename);
+            else
+                addDependency(mDependencies, absolute ? outPath + basename : mSourceDir + outPath + basename);
+        }
+
+        // TODO: save embedded images to file
+    }
+
+    return existing ? existing : omat;
+}
+
+
+/// a subset of an aiMesh that ends up in its own Ogre submesh
+struct AssimpLoader::SubMeshChunk
+{
+    std::vector<Ogre::uint32> vertices; // aiMesh vertex index of each chunk vertex
+    std::vector<Ogre::uint32> indices;  // triangle list referencing chunk vertices
+};
+
+/// bone weights of a single aiMesh vertex
+struct AssimpLoader::VertexInfluences
+{
+    Ogre::uint8 count;
+    Ogre::uint32 rawCount; // influences before limiting
+    unsigned short bones[OGRE_MAX_BLEND_WEIGHTS];
+    Ogre::Real weights[OGRE_MAX_BLEND_WEIGHTS];
+};
+
+/// CPU side contents of a submesh, filled by prepareSubMesh and uploaded by commitSubMesh
+struct AssimpLoader::PreparedSubMesh
+{
+    Ogre::String name;
+    bool hasNormals, hasUVs, hasTangents;
+    size_t vertexCount;
+    std::vector<Ogre::uint8> vertices;  // interleaved as declared by commitSubMesh
+    std::vector<Ogre::uint32> indices;
+    std::vector<float> positions;       // for the BVH
+    Ogre::AxisAlignedBox bounds;
+    Ogre::Real radius;
+    std::vector<Ogre::VertexBoneAssignment> boneAssignments;
+    Ogre::uint8 rawMaxInfluences;       // before limiting, for the stats
+    Ogre::uint8 keptMaxInfluences;
+    bool inCell;                        // goes to the chunk mesh of cell instead of the main mesh
+    GridCell cell;
+    Ogre::uint64 hash;                  // of the vertices, indices and bone assignments
+};
+
+/// an aiMesh referenced by a node
+struct AssimpLoader::MeshJob
+{
+    const aiNode* node;
+    const aiMesh* mesh;
+    unsigned int index;     // of the mesh in the node
+    bool skipped;           // no bone weights although the scene is animated
+    size_t splitChunks;     // chunks created by LP_SPLIT_LARGE_MESHES, 0 if not split
+    size_t chunks;          // chunks before splitting by bone palette
+    size_t paletteChunks;   // chunks after splitting by bone palette
+    std::vector<PreparedSubMesh> subMeshes;
+};
+
+/// the meshes of a node, committed together
+struct AssimpLoader::NodeBatch
+{
+    const aiNode* node;
+    bool included; // by the node filter
+    std::vector<MeshJob> jobs;
+};
+
+// largest vertex count that still gets a 16 bit index buffer in commitSubMesh
+static const size_t MAX_16BIT_VERTICES = 65535;
+
+static Ogre::uint32 expandMortonBits(Ogre::uint32 v)
+{
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v <<  8)) & 0x0300F00F;
+    v = (v | (v <<  4)) & 0x030C30C3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+/// splits the faces of mesh into chunks of at most maxVertices vertices
+/// faces are visited in morton order of their centroid, so each chunk covers a compact region
+/// and only vertices on the chunk boundaries get duplicated
+void AssimpLoader::splitMeshIntoChunks(const aiMesh* mesh, size_t maxVertices, std::vector<SubMeshChunk>& chunks)
+{
+    aiVector3D vmin = mesh->mVertices[0], vmax = mesh->mVertices[0];
+    for (unsigned int i = 1; i < mesh->mNumVertices; ++i)
+    {
+        const aiVector3D& p = mesh->mVertices[i];
+        vmin.x = std::min(vmin.x, p.x); vmin.y = std::min(vmin.y, p.y); vmin.z = std::min(vmin.z, p.z);
+        vmax.x = std::max(vmax.x, p.x); vmax.y = std::max(vmax.y, p.y); vmax.z = std::max(vmax.z, p.z);
+    }
+    aiVector3D extent = vmax - vmin;
+    aiVector3D scale(extent.x > 0 ? 1023 / extent.x : 0, extent.y > 0 ? 1023 / extent.y : 0, extent.z > 0 ? 1023 / extent.z : 0);
+
+    std::vector<std::pair<Ogre::uint32, Ogre::uint32> > order(mesh->mNumFaces);
+    for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+    {
+        const aiFace& face = mesh->mFaces[f];
+        aiVector3D c = (mesh->mVertices[face.mIndices[0]] + mesh->mVertices[face.mIndices[1]] + mesh->mVertices[face.mIndices[2]]) / 3.0f - vmin;
+        order[f].first = (expandMortonBits(Ogre::uint32(c.x * scale.x)) << 2) |
+                         (expandMortonBits(Ogre::uint32(c.y * scale.y)) << 1) |
+                          expandMortonBits(Ogre::uint32(c.z * scale.z));
+        order[f].second = f;
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<Ogre::uint32> localIndex(mesh->mNumVertices, ~0u);
+    chunks.push_back(SubMeshChunk());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const aiFace& face = mesh->mFaces[order[i].second];
+
+        size_t added = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (localIndex[face.mIndices[k]] == ~0u)
+                added++;
+        }
+
+        if (chunks.back().vertices.size() + added > maxVertices)
+        {
+            // reset the lookup for the vertices of the finished chunk only
+            for (Ogre::uint32 v : chunks.back().vertices)
+                localIndex[v] = ~0u;
+            chunks.push_back(SubMeshChunk());
+        }
+
+        SubMeshChunk& chunk = chunks.back();
+        for (int k = 0; k < 3; ++k)
+        {
+            Ogre::uint32& local = localIndex[face.mIndices[k]];
+            if (local == ~0u)
+            {
+                local = chunk.vertices.size();
+                chunk.vertices.push_back(face.mIndices[k]);
+            }
+            chunk.indices.push_back(local);
+        }
+    }
+}
+
+/// partitions the triangles of chunk into groups referencing at most maxBones bones each
+/// triangles go to the first group whose bone set still fits, trying the most recent group first
+void AssimpLoader::splitChunkByBones(const SubMeshChunk& chunk, const std::vector<VertexInfluences>& influences, size_t maxBones, std::vector<SubMeshChunk>& chunks)
+{
+    struct Group
+    {
+        std::set<unsigned short> bones;
+        std::map<Ogre::uint32, Ogre::uint32> localIndex;
+        SubMeshChunk chunk;
+    };
+    std::vector<Group> groups;
+
+    std::set<unsigned short> triBones;
+    for (size_t i = 0; i < chunk.indices.size(); i += 3)
+    {
+        triBones.clear();
+        for (int k = 0; k < 3; ++k)
+        {
+            const VertexInfluences& vi = influences[chunk.vertices[chunk.indices[i + k]]];
+            triBones.insert(vi.bones, vi.bones + vi.count);
+        }
+
+        Group* target = NULL;
+        for (size_t g = groups.size(); g-- > 0 && !target;)
+        {
+            size_t added = 0;
+            for (unsigned short b : triBones)
+                added += groups[g].bones.count(b) ? 0 : 1;
+            if (groups[g].bones.size() + added <= maxBones)
+                target = &groups[g];
+        }
+        if (!target)
+        {
+            // also taken when a single triangle exceeds the limit, it can not be split further
+            groups.push_back(Group());
+            target = &groups.back();
+        }
+
+        target->bones.insert(triBones.begin(), triBones.end());
+        for (int k = 0; k < 3; ++k)
+        {
+            Ogre::uint32 v = chunk.indices[i + k];
+            std::map<Ogre::uint32, Ogre::uint32>::iterator it = target->localIndex.find(v);
+            if (it == target->localIndex.end())
+            {
+                it = target->localIndex.insert(std::make_pair(v, Ogre::uint32(target->chunk.vertices.size()))).first;
+                target->chunk.vertices.push_back(chunk.vertices[v]);
+            }
+            target->chunk.indices.push_back(it->second);
+        }
+    }
+
+    for (Group& group : groups)
+    {
+        chunks.push_back(SubMeshChunk());
+        chunks.back().vertices.swap(group.chunk.vertices);
+        chunks.back().indices.swap(group.chunk.indices);
+    }
+}
+
+void AssimpLoader::splitChunkByCell(const SubMeshChunk& chunk, const aiMesh* mesh, const aiMatrix4x4& transform, Ogre::Real cellSize,
+                                    std::vector<SubMeshChunk>& chunks, std::vector<GridCell>& cells)
+{
+    // triangles go to the cell containing their centroid, so no triangle is cut
+    std::vector<std::pair<GridCell, Ogre::uint32> > order(chunk.indices.size() / 3);
+    for (size_t t = 0; t < order.size(); ++t)
+    {
+        aiVector3D centroid(0, 0, 0);
+        for (int k = 0; k < 3; ++k)
+        {
+            centroid += transform * mesh->mVertices[chunk.vertices[chunk.indices[t * 3 + k]]];
+        }
+        centroid /= 3.0f;
+
+        order[t].first = GridCell(int(std::floor(centroid.x / cellSize)), int(std::floor(centroid.y / cellSize)),
+                                  int(std::floor(centroid.z / cellSize)));
+        order[t].second = Ogre::uint32(t);
+    }
+    // sorting by cell, then triangle keeps the original triangle order inside each cell
+    std::sort(order.begin(), order.end());
+
+    std::vector<Ogre::uint32> localIndex(chunk.vertices.size(), ~0u);
+    std::vector<Ogre::uint32> used; // chunk vertices referenced by the current cell
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        if (i == 0 || order[i].first != order[i - 1].first)
+        {
+            // reset the lookup for the vertices of the finished cell only
+            for (Ogre::uint32 v : used)
+                localIndex[v] = ~0u;
+            used.clear();
+            cells.push_back(order[i].first);
+            chunks.push_back(SubMeshChunk());
+        }
+
+        SubMeshChunk& target = chunks.back();
+        for (int k = 0; k < 3; ++k)
+        {
+            Ogre::uint32 v = chunk.indices[order[i].second * 3 + k];
+            if (localIndex[v] == ~0u)
+            {
+                localIndex[v] = Ogre::uint32(target.vertices.size());
+                target.vertices.push_back(chunk.vertices[v]);
+                used.push_back(v);
+            }
+            target.indices.push_back(localIndex[v]);
+        }
+    }
+}
+
+AssimpLoader::Chunk& AssimpLoader::getChunk(const GridCell& cell, Ogre::Mesh* mesh)
+{
+    std::map<GridCell, size_t>::iterator it = mChunkByCell.find(cell);
+    if (it != mChunkByCell.end())
+    {
+        return mChunks[it->second];
+    }
+
+    Ogre::String basename, extension;
+    Ogre::StringUtil::splitBaseFilename(mesh->getName(), basename, extension);
+
+    Chunk chunk;
+    chunk.x = std::get<0>(cell);
+    chunk.y = std::get<1>(cell);
+    chunk.z = std::get<2>(cell);
+    chunk.radius = 0;
+
+    // a chunk of an earlier load of the same source is replaced, its holders keep the old mesh
+    Ogre::String name = Ogre::StringUtil::format("%s_%d_%d_%d.mesh", basename.c_str(), chunk.x, chunk.y, chunk.z);
+    Ogre::MeshPtr previous = Ogre::MeshManager::getSingleton().getByName(name, mesh->getGroup());
+    if (previous)
+    {
+        Ogre::MeshManager::getSingleton().remove(previous->getHandle());
+    }
+    chunk.mesh = Ogre::MeshManager::getSingleton().createManual(name, mesh->getGroup());
+
+    mChunkByCell[cell] = mChunks.size();
+    mChunks.push_back(chunk);
+    return mChunks.back();
+}
+
+void AssimpLoader::prepareMeshJob(MeshJob& job) const
+{
+    const aiMesh* mesh = job.mesh;
+
+    std::vector<VertexInfluences> influences;
+    if(mesh->HasBones())
+    {
+        gatherBoneInfluences(mesh, influences);
+    }
+
+    std::vector<SubMeshChunk> chunks;
+    if ((mLoaderParams & LP_SPLIT_LARGE_MESHES) && mesh->mNumVertices > MAX_16BIT_VERTICES)
+    {
+        splitMeshIntoChunks(mesh, MAX_16BIT_VERTICES, chunks);
+        job.splitChunks = chunks.size();
+    }
+    else
+    {
+        // a single chunk covering the whole mesh
+        chunks.resize(1);
+        SubMeshChunk& chunk = chunks.back();
+        chunk.vertices.resize(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+        {
+            chunk.vertices[i] = i;
+        }
+        chunk.indices.reserve(mesh->mNumFaces * 3);
+        for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            chunk.indices.insert(chunk.indices.end(), face.mIndices, face.mIndices + 3);
+        }
+    }
+
+    job.chunks = chunks.size();
+    if (mMaxBonesPerSubMesh && !influences.empty())
+    {
+        std::vector<SubMeshChunk> paletteChunks;
+        for (const SubMeshChunk& chunk : chunks)
+        {
+            splitChunkByBones(chunk, influences, mMaxBonesPerSubMesh, paletteChunks);
+        }
+        chunks.swap(paletteChunks);
+    }
+    job.paletteChunks = chunks.size();
+
+    // static geometry is partitioned into grid cells, each cell becomes a mesh of its own
+    std::vector<GridCell> cells;
+    if (mChunkSize > 0 && !mSkeleton)
+    {
+        const aiMatrix4x4& transform = mNodeDerivedTransformByName.find(job.node->mName.data)->second;
+        std::vector<SubMeshChunk> cellChunks;
+        for (const SubMeshChunk& chunk : chunks)
+        {
+            splitChunkByCell(chunk, mesh, transform, mChunkSize, cellChunks, cells);
+        }
+        chunks.swap(cellChunks);
+    }
+
+    job.subMeshes.resize(chunks.size());
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        PreparedSubMesh& prepared = job.subMeshes[c];
+        prepared.inCell = !cells.empty();
+        if (prepared.inCell)
+        {
+            prepared.cell = cells[c];
+        }
+        prepared.name = Ogre::String(job.node->mName.data) + Ogre::StringConverter::toString(job.index);
+        if (c > 0)
+        {
+            prepared.name += "_" + Ogre::StringConverter::toString(c);
+        }
+        prepareSubMesh(job, chunks[c], influences, prepared);
+    }
+}
+
+bool AssimpLoader::commitMeshJob(const aiScene* mScene, MeshJob& job, Ogre::Mesh* mMesh, Ogre::AxisAlignedBox& mAAB)
+{
+    const aiMesh* mesh = job.mesh;
+
+    if(!mQuietMode)
+    {
+        LOGSINK_LOG(LogSink::LEVEL_TRACE, "submesh", "SubMesh %u for mesh '%s'", unsigned(job.index), job.node->mName.data);
+    }
+
+    // if animated all submeshes must have bone weights
+    if(job.skipped)
+    {
+        if(!mQuietMode)
+        {
+            LOGSINK_LOG(LogSink::LEVEL_INFO, NULL, "Skipping Mesh %s with no bone weights", mesh->mName.data);
+        }
+        return false;
+    }
+
+    // Create a material instance for the mesh.
+    Ogre::MaterialPtr matptr;
+    if(!(mLoaderParams & (LP_SKIP_MATERIALS | LP_GEOMETRY_ONLY)))
+    {
+        matptr = createMaterial(mesh->mMaterialIndex, mScene->mMaterials[mesh->mMaterialIndex]);
+    }
+
+    if (job.splitChunks)
+    {
+        mStats.splitMeshes++;
+        mStats.splitSubMeshes += job.splitChunks;
+        mStats.indexBytesSaved += mesh->mNumFaces * 3 * (sizeof(Ogre::uint32) - sizeof(Ogre::uint16));
+
+        if(!mQuietMode)
+        {
+            Ogre::LogManager::getSingleton().logMessage("Splitting " + Ogre::StringConverter::toString(mesh->mNumVertices) +
+                                                        " vertices into " + Ogre::StringConverter::toString(job.splitChunks) + " 16 bit submeshes");
+        }
+    }
+
+    // counts are unsigned, only the draw calls the palette pass added are counted
+    if(job.paletteChunks > job.chunks)
+    {
+        mStats.paletteSplits += job.paletteChunks - job.chunks;
+        if(!mQuietMode)
+        {
+            Ogre::LogManager::getSingleton().logMessage("Splitting into " + Ogre::StringConverter::toString(job.paletteChunks) +
+                                                        " submeshes with at most " + Ogre::StringConverter::toString(mMaxBonesPerSubMesh) + " bones each");
+        }
+    }
+
+    for (PreparedSubMesh& prepared : job.subMeshes)
+    {
+        if (prepared.inCell)
+        {
+            Chunk& chunk = getChunk(prepared.cell, mMesh);
+            commitSubMesh(prepared, matptr, chunk.mesh.get(), chunk.bounds, chunk.radius);
         }
-        if(AI_SUCCESS == aiGetMaterialString(mat, AI_MATKEY_TEXTURE_DIFFUSE(0), &szPath))
+        else
         {
-            if(!mQuietMode)
-            {
-                Ogre::LogManager::getSingleton().logMessage("Using aiGetMaterialString : Found texture " + Ogre::String(szPath.data) + " for channel " + Ogre::StringConverter::toString(uvindex));
-            }
+            commitSubMesh(prepared, matptr, mMesh, mAAB, mBoundingRadius);
         }
-
-        Ogre::String basename;
-        Ogre::String outPath;
-        Ogre::StringUtil::splitFilename(Ogre::String(szPath.data), basename, outPath);
-        omat->getTechnique(0)->getPass(0)->createTextureUnitState(basename);
-
-        // TODO: save embedded images to file
+        // the data lives in the hardware buffers now
+        prepared = PreparedSubMesh();
     }
 
-    return omat;
+    return true;
 }
 
-
-bool AssimpLoader::createSubMesh(const Ogre::String& name, int index, const aiNode* pNode, const aiMesh *mesh, const aiMaterial* mat, Ogre::Mesh* mMesh, Ogre::AxisAlignedBox& mAAB)
+void AssimpLoader::gatherBoneInfluences(const aiMesh *mesh, std::vector<VertexInfluences>& influences) const
 {
-    // if animated all submeshes must have bone weights
-    if(mBonesByName.size() && !mesh->HasBones())
+    VertexInfluences empty = {};
+    influences.assign(mesh->mNumVertices, empty);
+
+    for ( Ogre::uint32 i=0; i < mesh->mNumBones; i++ )
     {
-        if(!mQuietMode)
+        aiBone *pAIBone = mesh->mBones[ i ];
+        if ( NULL == pAIBone || pAIBone->mNumWeights == 0 )
+            continue;
+
+        unsigned short handle = mSkeleton->getBone(pAIBone->mName.data)->getHandle();
+        for ( Ogre::uint32 weightIdx = 0; weightIdx < pAIBone->mNumWeights; weightIdx++ )
         {
-            Ogre::LogManager::getSingleton().logMessage("Skipping Mesh " + Ogre::String(mesh->mName.data) + "with no bone weights");
+            const aiVertexWeight& aiWeight = pAIBone->mWeights[ weightIdx ];
+            VertexInfluences& vi = influences[aiWeight.mVertexId];
+            vi.rawCount++;
+
+            // keep the strongest influences sorted by descending weight
+            int slot;
+            if (vi.count < mMaxBoneInfluences)
+                slot = vi.count++;
+            else if (vi.weights[vi.count - 1] < aiWeight.mWeight)
+                slot = vi.count - 1; // replaces the weakest
+            else
+                continue;
+            while (slot > 0 && vi.weights[slot - 1] < aiWeight.mWeight)
+            {
+                vi.bones[slot] = vi.bones[slot - 1];
+                vi.weights[slot] = vi.weights[slot - 1];
+                slot--;
+            }
+            vi.bones[slot] = handle;
+            vi.weights[slot] = aiWeight.mWeight;
         }
-        return false;
     }
 
-    Ogre::MaterialPtr matptr = createMaterial(mesh->mMaterialIndex, mat);
-
-    // now begin the object definition
-    // We create a submesh per material
-    Ogre::SubMesh* submesh = mMesh->createSubMesh(name + Ogre::StringConverter::toString(index));
+    for (VertexInfluences& vi : influences)
+    {
+        if (vi.count == 0)
+            continue;
 
-    // prime pointers to vertex related data
-    aiVector3D *vec = mesh->mVertices;
-    aiVector3D *norm = mesh->mNormals;
-    aiVector3D *uv = mesh->mTextureCoords[0];
-    //aiColor4D *col = mesh->mColors[0];
+        Ogre::Real total = 0;
+        for (int k = 0; k < vi.count; ++k)
+            total += vi.weights[k];
+        if (total <= 0)
+            continue;
 
-    // We must create the vertex data, indicating how many vertices there will be
-    submesh->useSharedVertices = false;
-    submesh->vertexData = new Ogre::VertexData();
-    submesh->vertexData->vertexStart = 0;
-    submesh->vertexData->vertexCount = mesh->mNumVertices;
+        for (int k = 0; k < vi.count; ++k)
+            vi.weights[k] /= total;
 
-    // We must now declare what the vertex data contains
-    Ogre::VertexDeclaration* declaration = submesh->vertexData->vertexDeclaration;
-    static const unsigned short source = 0;
-    size_t offset = 0;
-    offset += declaration->addElement(source,offset,Ogre::VET_FLOAT3,Ogre::VES_POSITION).getSize();
+        if (mLoaderParams & LP_QUANTISE_BONE_WEIGHTS)
+        {
+            // round to 1/255 steps, carrying the rounding error to the next weight
+            // the last weight takes the remainder so the quantised weights sum to exactly one
+            int remaining = 255;
+            Ogre::Real error = 0;
+            Ogre::uint8 kept = 0;
+            for (int k = 0; k < vi.count; ++k)
+            {
+                Ogre::Real target = vi.weights[k] * 255 + error;
+                int q = (k == vi.count - 1) ? remaining : std::min(remaining, std::max(0, int(target + 0.5f)));
+                error = target - q;
+                remaining -= q;
+                if (q == 0)
+                    continue;
+                vi.bones[kept] = vi.bones[k];
+                vi.weights[kept] = q / Ogre::Real(255);
+                kept++;
+            }
+            vi.count = kept;
+        }
+    }
+}
 
-    //mLog->logMessage((std::format(" %d vertices ") % m->mNumVertices).str());
-    if(!mQuietMode)
+/// rewrites the blend buffer compiled by Ogre with VET_UBYTE4_NORM weights
+static void packBlendWeights(Ogre::SubMesh* submesh)
+{
+    Ogre::VertexData* vertexData = submesh->vertexData;
+    Ogre::VertexDeclaration* decl = vertexData->vertexDeclaration;
+    const Ogre::VertexElement* indexElem = decl->findElementBySemantic(Ogre::VES_BLEND_INDICES);
+    if (!indexElem)
+        return;
+
+    unsigned short source = indexElem->getSource();
+
+    // blend indices refer to the submesh palette, invert it to map bone handles back
+    std::map<unsigned short, Ogre::uint8> blendIndexByHandle;
+    for (size_t i = 0; i < submesh->blendIndexToBoneIndexMap.size(); ++i)
+        blendIndexByHandle[submesh->blendIndexToBoneIndexMap[i]] = Ogre::uint8(i);
+
+    std::vector<Ogre::uint8> packed(vertexData->vertexCount * 8, 0);
+    std::vector<Ogre::uint8> slots(vertexData->vertexCount, 0);
+    for (const auto& entry : submesh->getBoneAssignments())
     {
-        Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(mesh->mNumVertices) + " vertices");
+        const Ogre::VertexBoneAssignment& vba = entry.second;
+        Ogre::uint8& slot = slots[vba.vertexIndex];
+        if (slot >= 4)
+            continue;
+        packed[vba.vertexIndex * 8 + slot] = blendIndexByHandle[vba.boneIndex];
+        packed[vba.vertexIndex * 8 + 4 + slot] = Ogre::uint8(vba.weight * 255 + 0.5f);
+        slot++;
     }
-    if (norm)
+
+    decl->removeElement(Ogre::VES_BLEND_INDICES);
+    decl->removeElement(Ogre::VES_BLEND_WEIGHTS);
+    decl->addElement(source, 0, Ogre::VET_UBYTE4, Ogre::VES_BLEND_INDICES);
+    decl->addElement(source, 4, Ogre::VET_UBYTE4_NORM, Ogre::VES_BLEND_WEIGHTS);
+
+    Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+        8, vertexData->vertexCount, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY, true);
+    vbuf->writeData(0, vbuf->getSizeInBytes(), packed.data(), true);
+    vertexData->vertexBufferBinding->setBinding(source, vbuf);
+}
+
+/// byte offsets of the elements of the single vertex buffer created per submesh
+struct VertexLayout
+{
+    size_t normal, uv, tangent, size;
+
+    VertexLayout(bool normals, bool uvs, bool tangents, Ogre::VertexElementType tangentType)
     {
-        if(!mQuietMode)
+        size = Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+        normal = uv = tangent = 0;
+        if (normals)
         {
-            Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(mesh->mNumVertices) + " normals");
+            normal = size;
+            size += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
         }
-        //mLog->logMessage((std::format(" %d normals ") % m->mNumVertices).str() );
-        offset += declaration->addElement(source,offset,Ogre::VET_FLOAT3,Ogre::VES_NORMAL).getSize();
-    }
-
-    if (uv)
-    {
-        if(!mQuietMode)
+        if (uvs)
         {
-            Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(mesh->mNumVertices) + " uvs");
+            uv = size;
+            size += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+        }
+        if (tangents)
+        {
+            tangent = size;
+            size += Ogre::VertexElement::getTypeSize(tangentType);
         }
-        //mLog->logMessage((std::format(" %d uvs ") % m->mNumVertices).str() );
-        offset += declaration->addElement(source,offset,Ogre::VET_FLOAT2,Ogre::VES_TEXTURE_COORDINATES).getSize();
     }
+};
 
-    /*
-    if (col)
-    {
-        Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(mesh->mNumVertices) + " colours");
-        //mLog->logMessage((std::format(" %d colours ") % m->mNumVertices).str() );
-        offset += declaration->addElement(source,offset,Ogre::VET_FLOAT3,Ogre::VES_DIFFUSE).getSize();
-    }
-    */
+void AssimpLoader::prepareSubMesh(const MeshJob& job, const SubMeshChunk& chunk, const std::vector<VertexInfluences>& influences, PreparedSubMesh& prepared) const
+{
+    const aiMesh* mesh = job.mesh;
+
+    // prime pointers to vertex related data
+    aiVector3D *vec = mesh->mVertices;
+    aiVector3D *norm = mesh->mNormals;
+    aiVector3D *uv = mesh->mTextureCoords[0];
+    //aiColor4D *col = mesh->mColors[0];
+    aiVector3D *tangent = (mLoaderParams & LP_EXPORT_TANGENTS) && norm ? mesh->mTangents : NULL;
+    aiVector3D *bitangent = mesh->mBitangents;
 
+    prepared.hasNormals = norm != NULL;
+    prepared.hasUVs = uv != NULL;
+    prepared.hasTangents = tangent != NULL;
+    prepared.vertexCount = chunk.vertices.size();
+    prepared.indices = chunk.indices;
 
-    // We create the hardware vertex buffer
-    Ogre::HardwareVertexBufferSharedPtr vbuffer =
-        Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(declaration->getVertexSize(source), // == offset
-        submesh->vertexData->vertexCount,   // == nbVertices
-        Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+    VertexLayout layout(prepared.hasNormals, prepared.hasUVs, prepared.hasTangents, mTangentType);
+    prepared.vertices.resize(layout.size * prepared.vertexCount);
 
-    aiMatrix4x4 aiM = mNodeDerivedTransformByName.find(pNode->mName.data)->second;
+    aiMatrix4x4 aiM = mNodeDerivedTransformByName.find(job.node->mName.data)->second;
 
     aiMatrix4x4 normalMatrix = aiM;
     normalMatrix.a4 = 0;
@@ -1037,15 +3239,21 @@ bool AssimpLoader::createSubMesh(const Ogre::String& name, int index, const aiNo
     normalMatrix.c4 = 0;
     normalMatrix.Transpose().Inverse();
 
-    // Now we get access to the buffer to fill it.  During so we record the bounding box.
-    float* vdata = static_cast<float*>(vbuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
-    for (size_t i=0;i < mesh->mNumVertices; ++i)
+    if(mLoaderParams & LP_BUILD_BVH)
+    {
+        prepared.positions.reserve(chunk.vertices.size() * 3);
+    }
+
+    // During so we record the bounding box.
+    prepared.radius = 0;
+    for (size_t i=0;i < chunk.vertices.size(); ++i)
     {
+        const size_t v = chunk.vertices[i];
+        Ogre::uint8* vertex = &prepared.vertices[i * layout.size];
+        float* vdata = reinterpret_cast<float*>(vertex);
+
         // Position
-        aiVector3D vect;
-        vect.x = vec->x;
-        vect.y = vec->y;
-        vect.z = vec->z;
+        aiVector3D vect = vec[v];
 
         vect *= aiM;
 
@@ -1060,36 +3268,48 @@ bool AssimpLoader::createSubMesh(const Ogre::String& name, int index, const aiNo
         *vdata++ = vect.x;
         *vdata++ = vect.y;
         *vdata++ = vect.z;
-        mAAB.merge(position);
-        vec++;
+        prepared.bounds.merge(position);
+        prepared.radius = std::max(prepared.radius, position.length());
+        if(mLoaderParams & LP_BUILD_BVH)
+        {
+            prepared.positions.push_back(vect.x);
+            prepared.positions.push_back(vect.y);
+            prepared.positions.push_back(vect.z);
+        }
 
         // Normal
+        aiVector3D normal;
         if (norm)
         {
-            vect.x = norm->x;
-            vect.y = norm->y;
-            vect.z = norm->z;
-
-            vect *= normalMatrix;
-            vect = vect.Normalize();
+            normal = norm[v];
 
-            *vdata++ = vect.x;
-            *vdata++ = vect.y;
-            *vdata++ = vect.z;
-            norm++;
+            normal *= normalMatrix;
+            normal = normal.Normalize();
 
-            //*vdata++ = norm->x;
-            //*vdata++ = norm->y;
-            //*vdata++ = norm->z;
-            //norm++;
+            vdata = reinterpret_cast<float*>(vertex + layout.normal);
+            *vdata++ = normal.x;
+            *vdata++ = normal.y;
+            *vdata++ = normal.z;
         }
 
         // uvs
         if (uv)
         {
-            *vdata++ = uv->x;
-            *vdata++ = uv->y;
-            uv++;
+            vdata = reinterpret_cast<float*>(vertex + layout.uv);
+            *vdata++ = uv[v].x;
+            *vdata++ = uv[v].y;
+        }
+
+        // tangent, orthogonalised against the normal
+        if (tangent)
+        {
+            aiMatrix3x3 basis(aiM);
+            aiVector3D t = basis * tangent[v];
+            t = (t - normal * (normal * t)).Normalize();
+            float handedness = 1;
+            if (bitangent && ((normal ^ t) * (basis * bitangent[v])) < 0)
+                handedness = -1;
+            packTangent(vertex + layout.tangent, mTangentType, t, handedness);
         }
 
         /*
@@ -1104,34 +3324,133 @@ bool AssimpLoader::createSubMesh(const Ogre::String& name, int index, const aiNo
         */
     }
 
-    vbuffer->unlock();
+    // set bone weigths
+    prepared.rawMaxInfluences = prepared.keptMaxInfluences = 0;
+    if(!influences.empty())
+    {
+        for (size_t i = 0; i < chunk.vertices.size(); ++i)
+        {
+            const VertexInfluences& vi = influences[chunk.vertices[i]];
+            prepared.rawMaxInfluences = std::max(prepared.rawMaxInfluences, Ogre::uint8(std::min<Ogre::uint32>(vi.rawCount, OGRE_MAX_BLEND_WEIGHTS)));
+            prepared.keptMaxInfluences = std::max(prepared.keptMaxInfluences, vi.count);
+
+            for (int k = 0; k < vi.count; ++k)
+            {
+                Ogre::VertexBoneAssignment vba;
+                vba.vertexIndex = i;
+                vba.boneIndex = vi.bones[k];
+                vba.weight = vi.weights[k];
+
+                prepared.boneAssignments.push_back(vba);
+            }
+        }
+    } // if mesh has bones
+
+    // the assignments are hashed field by field, the struct has padding
+    std::vector<Ogre::uint32> assignments;
+    assignments.reserve(prepared.boneAssignments.size() * 3);
+    for (const Ogre::VertexBoneAssignment& vba : prepared.boneAssignments)
+    {
+        Ogre::uint32 weight;
+        memcpy(&weight, &vba.weight, sizeof(weight));
+        assignments.insert(assignments.end(), {Ogre::uint32(vba.vertexIndex), Ogre::uint32(vba.boneIndex), weight});
+    }
+    Ogre::uint64 hashes[3] = {MeshBlobSerializer::hash(prepared.vertices.data(), prepared.vertices.size()),
+                              MeshBlobSerializer::hash(prepared.indices.data(), prepared.indices.size() * sizeof(Ogre::uint32)),
+                              MeshBlobSerializer::hash(assignments.data(), assignments.size() * sizeof(Ogre::uint32))};
+    prepared.hash = MeshBlobSerializer::hash(hashes, sizeof(hashes));
+}
+
+void AssimpLoader::commitSubMesh(PreparedSubMesh& prepared, const Ogre::MaterialPtr& matptr, Ogre::Mesh* mMesh, Ogre::AxisAlignedBox& mAAB, Ogre::Real& radius)
+{
+    // now begin the object definition
+    // We create a submesh per material
+    Ogre::SubMesh* submesh = mMesh->createSubMesh(prepared.name);
+
+    // We must create the vertex data, indicating how many vertices there will be
+    submesh->useSharedVertices = false;
+    submesh->vertexData = new Ogre::VertexData();
+    submesh->vertexData->vertexStart = 0;
+    submesh->vertexData->vertexCount = prepared.vertexCount;
+
+    // We must now declare what the vertex data contains, in the layout prepareSubMesh wrote
+    Ogre::VertexDeclaration* declaration = submesh->vertexData->vertexDeclaration;
+    static const unsigned short source = 0;
+    size_t offset = 0;
+    offset += declaration->addElement(source,offset,Ogre::VET_FLOAT3,Ogre::VES_POSITION).getSize();
+
+    //mLog->logMessage((std::format(" %d vertices ") % m->mNumVertices).str());
+    if(!mQuietMode)
+    {
+        LOGSINK_LOG(LogSink::LEVEL_TRACE, "submesh", "%zu vertices", submesh->vertexData->vertexCount);
+    }
+    if (prepared.hasNormals)
+    {
+        if(!mQuietMode)
+        {
+            LOGSINK_LOG(LogSink::LEVEL_TRACE, "submesh", "%zu normals", submesh->vertexData->vertexCount);
+        }
+        //mLog->logMessage((std::format(" %d normals ") % m->mNumVertices).str() );
+        offset += declaration->addElement(source,offset,Ogre::VET_FLOAT3,Ogre::VES_NORMAL).getSize();
+    }
+
+    if (prepared.hasUVs)
+    {
+        if(!mQuietMode)
+        {
+            LOGSINK_LOG(LogSink::LEVEL_TRACE, "submesh", "%zu uvs", submesh->vertexData->vertexCount);
+        }
+        //mLog->logMessage((std::format(" %d uvs ") % m->mNumVertices).str() );
+        offset += declaration->addElement(source,offset,Ogre::VET_FLOAT2,Ogre::VES_TEXTURE_COORDINATES).getSize();
+    }
+
+    if (prepared.hasTangents)
+    {
+        if(!mQuietMode)
+        {
+            LOGSINK_LOG(LogSink::LEVEL_TRACE, "submesh", "%zu tangents", submesh->vertexData->vertexCount);
+        }
+        offset += declaration->addElement(source,offset,mTangentType,Ogre::VES_TANGENT).getSize();
+    }
+
+    // We create the hardware vertex buffer and upload the prepared vertices
+    Ogre::HardwareVertexBufferSharedPtr vbuffer =
+        Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(declaration->getVertexSize(source), // == offset
+        submesh->vertexData->vertexCount,   // == nbVertices
+        Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+
+    vbuffer->writeData(0, prepared.vertices.size(), prepared.vertices.data(), true);
     submesh->vertexData->vertexBufferBinding->setBinding(source,vbuffer);
 
+    mAAB.merge(prepared.bounds);
+    radius = std::max(radius, prepared.radius);
+    // the BVH only covers the submeshes of the main mesh
+    const bool addToBVH = !prepared.inCell;
+    if (addToBVH)
+    {
+        mBVH.subMeshBounds.push_back(prepared.bounds);
+
+        Ogre::uint64 hash[2] = {prepared.hash, 0};
+        if (matptr)
+            hash[1] = MeshBlobSerializer::hash(matptr->getName().data(), matptr->getName().size());
+        mSubMeshHashes.push_back(MeshBlobSerializer::hash(hash, sizeof(hash)));
+    }
+
     if(!mQuietMode)
     {
-        Ogre::LogManager::getSingleton().logMessage(Ogre::StringConverter::toString(mesh->mNumFaces) + " faces");
+        LOGSINK_LOG(LogSink::LEVEL_TRACE, "submesh", "%zu faces", prepared.indices.size() / 3);
     }
-    aiFace *faces = mesh->mFaces;
 
     // Creates the index data
     submesh->indexData->indexStart = 0;
-    submesh->indexData->indexCount = mesh->mNumFaces * 3;
+    submesh->indexData->indexCount = prepared.indices.size();
 
-    if (mesh->mNumVertices >= 65536) // 32 bit index buffer
+    if (submesh->vertexData->vertexCount > MAX_16BIT_VERTICES) // 32 bit index buffer
     {
         submesh->indexData->indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
                 Ogre::HardwareIndexBuffer::IT_32BIT, submesh->indexData->indexCount, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
 
-        Ogre::uint32* indexData = static_cast<Ogre::uint32*>(submesh->indexData->indexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
-
-        for (size_t i=0; i < mesh->mNumFaces;++i)
-        {
-            *indexData++ = faces->mIndices[0];
-            *indexData++ = faces->mIndices[1];
-            *indexData++ = faces->mIndices[2];
-
-            faces++;
-        }
+        submesh->indexData->indexBuffer->writeData(0, submesh->indexData->indexBuffer->getSizeInBytes(), prepared.indices.data(), true);
     }
     else // 16 bit index buffer
     {
@@ -1140,77 +3459,303 @@ bool AssimpLoader::createSubMesh(const Ogre::String& name, int index, const aiNo
 
         Ogre::uint16* indexData = static_cast<Ogre::uint16*>(submesh->indexData->indexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
 
-        for (size_t i=0; i < mesh->mNumFaces;++i)
+        for (size_t i=0; i < prepared.indices.size(); ++i)
         {
-            *indexData++ = faces->mIndices[0];
-            *indexData++ = faces->mIndices[1];
-            *indexData++ = faces->mIndices[2];
-
-            faces++;
+            *indexData++ = Ogre::uint16(prepared.indices[i]);
         }
-    }
 
-    submesh->indexData->indexBuffer->unlock();
+        submesh->indexData->indexBuffer->unlock();
+    }
 
-    // set bone weigths
-    if(mesh->HasBones())
+    if((mLoaderParams & LP_BUILD_BVH) && addToBVH)
     {
-        for ( Ogre::uint32 i=0; i < mesh->mNumBones; i++ )
+        TriangleBVH::Triangle tri;
+        tri.subMesh = mMesh->getNumSubMeshes() - 1;
+        for (size_t i = 0; i < prepared.indices.size(); i += 3)
         {
-            aiBone *pAIBone = mesh->mBones[ i ];
-            if ( NULL != pAIBone )
+            for (int k = 0; k < 3; ++k)
             {
-                Ogre::String bname = pAIBone->mName.data;
-                for ( Ogre::uint32 weightIdx = 0; weightIdx < pAIBone->mNumWeights; weightIdx++ )
-                {
-                    aiVertexWeight aiWeight = pAIBone->mWeights[ weightIdx ];
+                const float* p = &prepared.positions[prepared.indices[i + k] * 3];
+                std::copy(p, p + 3, tri.v[k]);
+            }
+            tri.face = i / 3;
+            mBVHTriangles.push_back(tri);
+        }
+    }
 
-                    Ogre::VertexBoneAssignment vba;
-                    vba.vertexIndex = aiWeight.mVertexId;
-                    vba.boneIndex = mSkeleton->getBone(bname)->getHandle();
-                    vba.weight= aiWeight.mWeight;
+    // set bone weigths
+    if(!prepared.boneAssignments.empty())
+    {
+        for (const Ogre::VertexBoneAssignment& vba : prepared.boneAssignments)
+        {
+            submesh->addBoneAssignment(vba);
+        }
 
-                    submesh->addBoneAssignment(vba);
-                }
+        // indices are 4 bytes, weights a float each or 4 bytes when quantised
+        mStats.blendBytesBefore += prepared.vertexCount * (4 + prepared.rawMaxInfluences * sizeof(float));
+        // compile now so the palette of each split submesh is known up front
+        if (mMaxBonesPerSubMesh || (mLoaderParams & LP_QUANTISE_BONE_WEIGHTS))
+        {
+            submesh->_compileBoneAssignments();
+            if(!mQuietMode && mMaxBonesPerSubMesh)
+            {
+                LOGSINK_LOG(LogSink::LEVEL_TRACE, "submesh", "%zu bones in palette", submesh->blendIndexToBoneIndexMap.size());
             }
         }
+
+        if (mLoaderParams & LP_QUANTISE_BONE_WEIGHTS)
+        {
+            packBlendWeights(submesh);
+            mStats.blendBytesAfter += prepared.vertexCount * 8;
+        }
+        else
+        {
+            mStats.blendBytesAfter += prepared.vertexCount * (4 + prepared.keptMaxInfluences * sizeof(float));
+        }
     } // if mesh has bones
 
+    // reorganise now rather than after the whole mesh, so only one submesh is held twice at a time.
+    // the skeleton is linked at the end of _load, but it exists already
+    Ogre::VertexDeclaration* newDcl =
+        submesh->vertexData->vertexDeclaration->getAutoOrganisedDeclaration(bool(mSkeleton), mMesh->hasVertexAnimation(), false);
+
+    if (*newDcl != *(submesh->vertexData->vertexDeclaration))
+    {
+        submesh->vertexData->reorganiseBuffers(newDcl);
+    }
+
     // Finally we set a material to the submesh
     if (matptr)
         submesh->setMaterialName(matptr->getName());
-
-    return true;
 }
 
-void AssimpLoader::loadDataFromNode(const aiScene* mScene, const aiNode *pNode, Ogre::Mesh* mesh)
+void AssimpLoader::collectMeshJobs(const aiScene* mScene, const aiNode *pNode, bool nodeIncluded, std::vector<NodeBatch>& batches) const
 {
+    // a node matching the filter brings in its whole subtree
+    nodeIncluded = nodeIncluded || matchesFilter(pNode->mName.data, mNodeFilter, mNodeRegex);
+
     if(pNode->mNumMeshes > 0)
     {
-        Ogre::AxisAlignedBox mAAB = mesh->getBounds();
+        batches.push_back(NodeBatch());
+        NodeBatch& batch = batches.back();
+        batch.node = pNode;
+        batch.included = nodeIncluded;
 
-        for ( unsigned int idx=0; idx<pNode->mNumMeshes; ++idx )
+        for ( unsigned int idx=0; idx<pNode->mNumMeshes && nodeIncluded; ++idx )
         {
-            aiMesh *pAIMesh = mScene->mMeshes[ pNode->mMeshes[ idx ] ];
-            if(!mQuietMode)
+            const aiMesh *pAIMesh = mScene->mMeshes[ pNode->mMeshes[ idx ] ];
+            if(!matchesFilter(pAIMesh->mName.data, mMeshFilter, mMeshRegex))
             {
-                Ogre::LogManager::getSingleton().logMessage("SubMesh " + Ogre::StringConverter::toString(idx) + " for mesh '" + Ogre::String(pNode->mName.data) + "'");
+                continue;
             }
 
-            // Create a material instance for the mesh.
-            const aiMaterial *pAIMaterial = mScene->mMaterials[ pAIMesh->mMaterialIndex ];
-            createSubMesh(pNode->mName.data, idx, pNode, pAIMesh, pAIMaterial, mesh, mAAB);
+            MeshJob job;
+            job.node = pNode;
+            job.mesh = pAIMesh;
+            job.index = idx;
+            job.skipped = mBonesByName.size() && !pAIMesh->HasBones();
+            job.splitChunks = job.chunks = job.paletteChunks = 0;
+            batch.jobs.push_back(job);
         }
-
-        // We must indicate the bounding box
-        mesh->_setBounds(mAAB);
-        mesh->_setBoundingSphereRadius((mAAB.getMaximum()- mAAB.getMinimum()).length()/2);
     }
 
     // Traverse all child nodes of the current node instance
     for ( unsigned int childIdx=0; childIdx<pNode->mNumChildren; childIdx++ )
     {
-        const aiNode *pChildNode = pNode->mChildren[ childIdx ];
-        loadDataFromNode(mScene, pChildNode, mesh);
+        collectMeshJobs(mScene, pNode->mChildren[ childIdx ], nodeIncluded, batches);
+    }
+}
+
+/// counts the edges of a triangle list submesh used by more than two triangles, vertices welded by position
+static size_t countNonManifoldEdges(const Ogre::Mesh* mesh, const Ogre::SubMesh* submesh)
+{
+    const Ogre::VertexData* vertexData = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+    const Ogre::IndexData* indexData = submesh->indexData;
+    if (submesh->operationType != Ogre::RenderOperation::OT_TRIANGLE_LIST || !vertexData || !indexData->indexBuffer)
+        return 0;
+    const Ogre::VertexElement* position = vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+    if (!position || position->getType() != Ogre::VET_FLOAT3)
+        return 0;
+
+    const Ogre::HardwareVertexBufferSharedPtr& vbuffer = vertexData->vertexBufferBinding->getBuffer(position->getSource());
+    std::vector<Ogre::uchar> vertices(vbuffer->getSizeInBytes());
+    vbuffer->readData(0, vertices.size(), vertices.data());
+    const size_t stride = vbuffer->getVertexSize();
+
+    // welded index of every vertex, by the bits of its position
+    std::map<std::array<Ogre::uint32, 3>, Ogre::uint32> positions;
+    std::vector<Ogre::uint32> welded(vertexData->vertexCount);
+    for (size_t v = 0; v < vertexData->vertexCount; ++v)
+    {
+        std::array<Ogre::uint32, 3> key;
+        memcpy(key.data(), &vertices[(vertexData->vertexStart + v) * stride + position->getOffset()], sizeof(key));
+        welded[v] = positions.insert(std::make_pair(key, Ogre::uint32(positions.size()))).first->second;
+    }
+
+    const Ogre::HardwareIndexBufferSharedPtr& ibuffer = indexData->indexBuffer;
+    std::vector<Ogre::uint32> indices(indexData->indexCount);
+    if (ibuffer->getType() == Ogre::HardwareIndexBuffer::IT_32BIT)
+    {
+        ibuffer->readData(indexData->indexStart * sizeof(Ogre::uint32), indices.size() * sizeof(Ogre::uint32), indices.data());
+    }
+    else
+    {
+        std::vector<Ogre::uint16> shortIndices(indexData->indexCount);
+        ibuffer->readData(indexData->indexStart * sizeof(Ogre::uint16), shortIndices.size() * sizeof(Ogre::uint16), shortIndices.data());
+        std::copy(shortIndices.begin(), shortIndices.end(), indices.begin());
+    }
+
+    std::unordered_map<Ogre::uint64, Ogre::uint32> triangleCount;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (int e = 0; e < 3; ++e)
+        {
+            // indices are relative to vertexStart
+            Ogre::uint32 ia = indices[i + e], ib = indices[i + (e + 1) % 3];
+            if (ia >= welded.size() || ib >= welded.size())
+                continue;
+            Ogre::uint32 a = welded[ia], b = welded[ib];
+            if (a == b)
+                continue;
+            triangleCount[Ogre::uint64(std::min(a, b)) << 32 | std::max(a, b)]++;
+        }
+    }
+
+    size_t nonManifold = 0;
+    for (const auto& edge : triangleCount)
+    {
+        if (edge.second > 2)
+            nonManifold++;
+    }
+    return nonManifold;
+}
+
+void AssimpLoader::buildEdgeLists(const std::vector<Ogre::Mesh*>& meshes, unsigned int threads, EdgeListReport& report)
+{
+    if (!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::pair<Ogre::Mesh*, unsigned short> > submeshes;
+    for (Ogre::Mesh* mesh : meshes)
+    {
+        for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+            submeshes.push_back(std::make_pair(mesh, i));
+    }
+
+    // the check reads the buffers, so it runs before the edge list builders lock them
+    std::vector<size_t> nonManifold(submeshes.size());
+    parallelFor(submeshes.size(), threads, [&](size_t i) {
+        nonManifold[i] = countNonManifoldEdges(submeshes[i].first, submeshes[i].first->getSubMesh(submeshes[i].second));
+    });
+    for (size_t i = 0; i < submeshes.size(); ++i)
+    {
+        if (!nonManifold[i])
+            continue;
+        report.nonManifoldEdges += nonManifold[i];
+        report.warnings.push_back(Ogre::StringUtil::format("%s submesh %u has %zu non-manifold edges",
+                                                           submeshes[i].first->getName().c_str(),
+                                                           unsigned(submeshes[i].second), nonManifold[i]));
+    }
+
+    // the builder joins edges across the submeshes of a mesh, so a mesh is the unit of work
+    parallelFor(meshes.size(), threads, [&](size_t i) { meshes[i]->buildEdgeList(); });
+
+    for (Ogre::Mesh* mesh : meshes)
+    {
+        for (unsigned short lod = 0; lod < mesh->getNumLodLevels(); ++lod)
+        {
+            const Ogre::EdgeData* edgeData = mesh->getEdgeList(lod);
+            if (!edgeData)
+                continue;
+            for (const Ogre::EdgeData::EdgeGroup& group : edgeData->edgeGroups)
+            {
+                report.edges += group.edges.size();
+                for (const Ogre::EdgeData::Edge& edge : group.edges)
+                {
+                    if (edge.degenerate)
+                        report.openEdges++;
+                }
+            }
+        }
+    }
+}
+
+void AssimpLoader::loadMeshes(const aiScene* mScene, Ogre::Mesh* mesh)
+{
+    std::vector<NodeBatch> batches;
+    collectMeshJobs(mScene, mScene->mRootNode, false, batches);
+
+    std::vector<MeshJob*> jobs;
+    for (NodeBatch& batch : batches)
+    {
+        for (MeshJob& job : batch.jobs)
+        {
+            if (!job.skipped)
+                jobs.push_back(&job);
+        }
+    }
+
+    // the prepare phase only reads the scene and the loader state, so the meshes are independent tasks.
+    // with LP_LOW_MEMORY each node is prepared right before its commit, so its meshes can be freed in between
+    const bool lowMemory = !mMeshUseCount.empty();
+    size_t prepared = 0;
+
+    // mBonesByName points into the bones of the meshes freed below, it is not needed past the job list
+    if (lowMemory)
+        mBonesByName.clear();
+
+    // preparing and committing a job count as one step each
+    const std::thread::id loadingThread = std::this_thread::get_id();
+    const float steps = std::max<size_t>(1, jobs.size() * 2);
+    std::atomic<size_t> done(0);
+
+    for (NodeBatch& batch : batches)
+    {
+        if (lowMemory || prepared == 0)
+        {
+            size_t end = lowMemory ? prepared + std::count_if(batch.jobs.begin(), batch.jobs.end(),
+                                                             [](const MeshJob& job) { return !job.skipped; })
+                                   : jobs.size();
+            parallelFor(end - prepared, mThreads, [&](size_t i) {
+                if (mCancelled)
+                    return;
+                prepareMeshJob(*jobs[prepared + i]);
+                size_t step = ++done;
+                // the callback only runs on the loading thread
+                if (std::this_thread::get_id() == loadingThread)
+                    reportProgress(PHASE_SUBMESHES, step / steps);
+            });
+            prepared = end;
+        }
+
+        if (mCancelled)
+            return;
+
+        // committing in node order creates the same submeshes as a serial load
+        if (batch.included)
+        {
+            Ogre::AxisAlignedBox mAAB = mesh->getBounds();
+            for (MeshJob& job : batch.jobs)
+            {
+                commitMeshJob(mScene, job, mesh, mAAB);
+                if (!job.skipped && !reportProgress(PHASE_SUBMESHES, ++done / steps))
+                    return;
+            }
+
+            // We must indicate the bounding box
+            // the bounding sphere is centred on the mesh origin, so use the farthest vertex
+            mesh->_setBounds(mAAB);
+            mesh->_setBoundingSphereRadius(mBoundingRadius);
+        }
+
+        if (lowMemory)
+        {
+            for ( unsigned int idx=0; idx<batch.node->mNumMeshes; ++idx )
+            {
+                // nodes visited later do not reference it anymore
+                if(--mMeshUseCount[batch.node->mMeshes[idx]] == 0)
+                    mStats.meshBytesReleased += releaseMeshData(mScene->mMeshes[batch.node->mMeshes[idx]]);
+            }
+        }
     }
 }
@@ -38,8 +38,16 @@ THE SOFTWARE.
 
 #include <OgreMesh.h>
 
+#include <atomic>
+#include <functional>
+#include <regex>
+#include <tuple>
+
 #include <assimp/scene.h>
 
+#include "LoadArena.h"
+#include "TriangleBVH.h"
+
 namespace Assimp
 {
     class Importer;
@@ -55,17 +63,126 @@ public:
         LP_CUT_ANIMATION_WHERE_NO_FURTHER_CHANGE = 1<<0,
 
         // Quiet mode - don't output anything
-        LP_QUIET_MODE = 1<<1
+        LP_QUIET_MODE = 1<<1,
+
+        // split meshes that would need a 32 bit index buffer into spatially coherent
+        // submeshes that each fit 16 bit indices
+        LP_SPLIT_LARGE_MESHES = 1<<2,
+
+        // build a triangle BVH over the imported geometry for picking, see getBVH
+        LP_BUILD_BVH = 1<<3,
+
+        // drop bones without vertex weights and animation channels, folding their
+        // transforms into the remaining children
+        LP_PRUNE_UNUSED_BONES = 1<<4,
+
+        // round bone weights to 8 bit with error diffusion and store them as VET_UBYTE4_NORM
+        // needs hardware skinning, software skinning reads float weights. The packed buffer only
+        // lives in memory, a .mesh keeps the rounded bone assignments and Ogre compiles float
+        // weights from them when loading it
+        LP_QUANTISE_BONE_WEIGHTS = 1<<5,
+
+        // selective import, the matching Assimp post-process steps are skipped as well
+        LP_SKIP_MATERIALS = 1<<6,
+        LP_SKIP_NORMALS = 1<<7,
+        LP_SKIP_UVS = 1<<8,
+        // positions and indices only, no materials, skeleton or animations
+        LP_GEOMETRY_ONLY = 1<<9,
+        // skeleton and animations only, no submeshes or materials
+        LP_ANIMATIONS_ONLY = 1<<10,
+
+        // nodeFilter and meshFilter are regular expressions instead of glob patterns, a malformed
+        // expression logs an error and fails the load
+        LP_REGEX_FILTERS = 1<<11,
+
+        // take ownership of the Assimp scene and free each mesh as soon as it was converted
+        LP_LOW_MEMORY = 1<<12,
+
+        // write Assimp's tangents as a packed VES_TANGENT stream, see Options::tangentType
+        LP_EXPORT_TANGENTS = 1<<13,
+
+        // name the skeleton after the hash of its bones and clips and reuse an already
+        // loaded skeleton with that name instead of creating a new one, see hashSkeleton
+        LP_SHARE_SKELETONS = 1<<14,
+
+        // generate normals and tangents and join vertices with MeshPostProcess, one thread per
+        // mesh, instead of with Assimp's serial steps
+        LP_PARALLEL_POSTPROCESS = 1<<15,
+
+        // stream loads: look up the files Assimp asks for in a name index of the resource group,
+        // built once per load, instead of searching every archive of the group for each. Paths
+        // the group has elsewhere resolve by file name if exactly one resource has it
+        LP_INDEX_RESOURCES = 1<<16,
+
+        // stream loads: read the buffers of .gltf and the material libraries of .obj in the
+        // background as soon as the load starts, reading archives in parallel needs an Ogre
+        // built with thread support unless they are on the file system
+        LP_PREFETCH_EXTERNALS = 1<<17
     };
 
+    /// stages of a load in the order they run, reported to Options::progress
+    enum LoadPhase
+    {
+        PHASE_PARSE,        // Assimp reading the file
+        PHASE_POSTPROCESS,  // Assimp post processing steps
+        PHASE_SKELETON,     // creating the bones
+        PHASE_ANIMATIONS,   // converting the animation clips
+        PHASE_SUBMESHES     // preparing and committing the submeshes
+    };
+
+    /** called on the loading thread with the progress in [0, 1] within phase
+
+        Return false to cancel the load. The load then returns false, the submeshes it added to the
+        mesh are destroyed, the bounds are restored and the skeleton and chunk meshes are removed from
+        their managers. Assimp only checks for cancellation between its own steps.
+    */
+    typedef std::function<bool(LoadPhase phase, float progress)> ProgressCallback;
+
     struct Options
     {
         float animationSpeedModifier;
         int params;
         Ogre::String customAnimationName;
         float maxEdgeAngle;
+        unsigned short maxBoneInfluences; // 1, 2 or 4 weights per vertex, renormalised, 3 becomes 2
+        unsigned short maxBonesPerSubMesh; // split skinned submeshes to fit this palette size, 0 for no limit
+        Ogre::StringVector animations; // clips to import by their skeleton names, all if empty
+        Ogre::String nodeFilter; // only import meshes below nodes matching this, all if empty
+        Ogre::String meshFilter; // only import meshes with a name matching this, all if empty
+        Ogre::VertexElementType tangentType; // VET_SHORT4_NORM or VET_INT_10_10_10_2_NORM, handedness in w
+        unsigned int threads; // threads preparing the submeshes, 0 for one per core
+        Ogre::Real chunkSize; // partition static geometry into meshes per grid cell of this size, 0 to disable
+        ProgressCallback progress; // progress per phase, may cancel the load
+        std::map<Ogre::String, Ogre::String> boneNameMap; // channel name -> bone name, for loadAnimations
 
-        Options() : animationSpeedModifier(1), params(0), maxEdgeAngle(30) {}
+        Options()
+            : animationSpeedModifier(1), params(0), maxEdgeAngle(30), maxBoneInfluences(4), maxBonesPerSubMesh(0),
+              tangentType(Ogre::VET_SHORT4_NORM), threads(0), chunkSize(0)
+        {
+        }
+    };
+
+    /// counters gathered during the last load
+    struct Stats
+    {
+        size_t splitMeshes;     // meshes split to fit 16 bit indices
+        size_t splitSubMeshes;  // submeshes created by the split
+        size_t indexBytesSaved; // index buffer bytes saved by the split
+        size_t bonesPruned;     // bones removed by LP_PRUNE_UNUSED_BONES
+        size_t blendBytesBefore; // blend index/weight bytes with all influences as floats
+        size_t blendBytesAfter;  // blend index/weight bytes in memory after limiting and quantising
+        size_t paletteSplits;    // draw calls added to fit maxBonesPerSubMesh
+        size_t meshBytesReleased; // Assimp mesh data freed early by LP_LOW_MEMORY
+        size_t transientAllocations; // node, bone and keyframe lookup entries, each a heap allocation without the arena
+        size_t transientHeapAllocations; // heap blocks the arena took for them
+        size_t channelsSkipped; // animation channels without a matching bone
+
+        Stats()
+            : splitMeshes(0), splitSubMeshes(0), indexBytesSaved(0), bonesPruned(0), blendBytesBefore(0),
+              blendBytesAfter(0), paletteSplits(0), meshBytesReleased(0), transientAllocations(0),
+              transientHeapAllocations(0), channelsSkipped(0)
+        {
+        }
     };
 
     AssimpLoader();
@@ -77,43 +194,284 @@ public:
     bool load(const Ogre::DataStreamPtr& source, const Ogre::String& type, Ogre::Mesh* mesh,
               Ogre::SkeletonPtr& skeletonPtr, const Options& options = Options());
 
+    const Stats& getStats() const { return mStats; }
+
+    /// auxiliary file access of the last stream load, see LP_INDEX_RESOURCES and LP_PREFETCH_EXTERNALS
+    struct IOStats
+    {
+        size_t indexedNames;        // entries of the name index
+        double indexSeconds;        // building the index
+        size_t lookups;             // files resolved through the index
+        size_t indexMisses;         // files the index answered as missing
+        double openSeconds;         // spent in opening auxiliary files, waiting for prefetches included
+        size_t prefetchedFiles;     // files read in the background
+        size_t prefetchHits;        // opens served by a prefetch
+        size_t prefetchBytes;       // bytes served by prefetches
+        double prefetchWaitSeconds; // opens waiting for a prefetch to finish
+
+        IOStats()
+            : indexedNames(0), indexSeconds(0), lookups(0), indexMisses(0), openSeconds(0), prefetchedFiles(0),
+              prefetchHits(0), prefetchBytes(0), prefetchWaitSeconds(0)
+        {
+        }
+    };
+
+    const IOStats& getIOStats() const { return mIOStats; }
+
+    /** appends the animations of source to skeleton, which an earlier load or a .skeleton file created
+
+        Only the clips are read, meshes, materials and nodes are not converted. Channels are matched
+        to the bones of skeleton by name, after renaming them with Options::boneNameMap, and channels
+        without a bone are counted in Stats::channelsSkipped. Clips named like an existing one
+        replace it. Clips appended before a cancel stay. Skeletons shared by LP_SHARE_SKELETONS
+        are refused, as their name stands for their clips.
+    */
+    bool loadAnimations(const Ogre::String& source, const Ogre::SkeletonPtr& skeleton, const Options& options = Options());
+
+    bool loadAnimations(const Ogre::DataStreamPtr& source, const Ogre::String& type, const Ogre::SkeletonPtr& skeleton,
+                        const Options& options = Options());
+
+    /// what reimport changed
+    struct ReimportResult
+    {
+        size_t subMeshesUnchanged;
+        size_t subMeshesUpdated;  // took over the new buffers, the SubMesh object stays
+        size_t subMeshesAdded;
+        size_t subMeshesRemoved;
+        size_t animationsUnchanged;
+        size_t animationsUpdated; // keyframes replaced in the existing Animation
+        size_t animationsAdded;
+        size_t animationsRemoved;
+        size_t materialsUpdated;  // parameters rewritten in the existing Material
+        bool lodsRemoved; // the LOD levels were built from the old geometry, generate them again
+        /// submeshes were added or removed, got buffers of another size or layout, the LODs were removed
+        /// or the skeleton was replaced, recreate the entities
+        bool rebuilt;
+
+        ReimportResult()
+            : subMeshesUnchanged(0), subMeshesUpdated(0), subMeshesAdded(0), subMeshesRemoved(0), animationsUnchanged(0),
+              animationsUpdated(0), animationsAdded(0), animationsRemoved(0), materialsUpdated(0), lodsRemoved(false), rebuilt(false)
+        {
+        }
+    };
+
+    /** loads source again into mesh and skeletonPtr, which an earlier load filled
+
+        The source is loaded into a scratch mesh and only what changed is moved over, so the Mesh,
+        SubMesh, Skeleton, Animation and Material objects stay valid for entities using them.
+        Changed submeshes are found by the content hashes the loads store in the mesh's
+        UserObjectBindings and written into the existing buffers where size and layout allow. Edge
+        lists are rebuilt. If the bones are unchanged, animations are updated keyframe by keyframe,
+        otherwise skeletonPtr is replaced. Materials are only rewritten once the load succeeded.
+        Chunking is not supported.
+    */
+    bool reimport(const Ogre::String& source, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr, ReimportResult& result,
+                  const Options& options = Options());
+
+    bool reimport(const Ogre::DataStreamPtr& source, const Ogre::String& type, Ogre::Mesh* mesh,
+                  Ogre::SkeletonPtr& skeletonPtr, ReimportResult& result, const Options& options = Options());
+
+    /// UserObjectBindings key of the std::vector<Ogre::uint64> with a content hash per submesh
+    static const char* SUBMESH_HASHES;
+
+    /// group name -> clip names
+    typedef std::map<Ogre::String, Ogre::StringVector> AnimationGroups;
+
+    /** Moves the animations of skeleton into animation-only skeletons
+
+        Every group becomes a skeleton named <skeleton basename>_<group>.skeleton that carries
+        the bones of skeleton plus the clips of the group. Clips not listed in any group get a
+        skeleton of their own named after the clip. The results can be attached on demand with
+        Skeleton::addLinkedSkeletonAnimationSource and detached again with
+        Skeleton::removeAllLinkedSkeletonAnimationSources.
+    */
+    static void splitAnimations(const Ogre::SkeletonPtr& skeleton, const AnimationGroups& groups,
+                                std::vector<Ogre::SkeletonPtr>& animationSkeletons);
+
+    /** identity of the bones of skeleton
+
+        Hashes the bone names, the hierarchy and the bind pose, quantised to 1e-4, in handle order.
+        Skeletons with the same hash can drive each other's meshes.
+    */
+    static Ogre::uint64 hashSkeleton(const Ogre::Skeleton* skeleton);
+
+    /// what buildEdgeLists found
+    struct EdgeListReport
+    {
+        size_t edges;
+        size_t openEdges;        // used by one triangle, the mesh is not closed
+        size_t nonManifoldEdges; // used by more than two triangles, shadow volumes may show artefacts
+        Ogre::StringVector warnings; // one per submesh with non-manifold edges
+
+        EdgeListReport() : edges(0), openEdges(0), nonManifoldEdges(0) {}
+    };
+
+    /** builds the edge lists of all LODs of meshes, so MeshSerializer writes them along
+
+        Stencil shadows and silhouette detection otherwise build them on first use. The meshes are
+        built in parallel and every triangle list submesh is checked for non-manifold edges, with
+        the vertices welded by position, in parallel as well. threads 0 uses one per core.
+    */
+    static void buildEdgeLists(const std::vector<Ogre::Mesh*>& meshes, unsigned int threads, EdgeListReport& report);
+
+    /// whether the last load reused a skeleton loaded before, see LP_SHARE_SKELETONS
+    bool isSkeletonShared() const { return mSkeletonShared; }
+
+    /// tight bounds of every submesh created by the last load
+    const std::vector<Ogre::AxisAlignedBox>& getSubMeshBounds() const { return mBVH.subMeshBounds; }
+
+    /// hierarchy built by the last load with LP_BUILD_BVH
+    const TriangleBVH& getBVH() const { return mBVH; }
+
+    /// a grid cell of static geometry split off by Options::chunkSize
+    struct Chunk
+    {
+        int x, y, z;                 // cell index, the cell spans [x, x + 1) * chunkSize on the x axis
+        Ogre::MeshPtr mesh;          // named <mesh basename>_<x>_<y>_<z>.mesh, replaces a managed mesh of that name
+        Ogre::AxisAlignedBox bounds; // tight bounds of the geometry in the chunk
+        Ogre::Real radius;           // bounding sphere radius around the origin
+    };
+
+    /// meshes created for the grid cells by the last load
+    const std::vector<Chunk>& getChunks() const { return mChunks; }
+
+    /** files read by the last load
+
+        The source file and every auxiliary file Assimp opened (.mtl, .bin, ...) plus the
+        referenced textures. Paths are as opened for file loads, resource names for stream loads.
+    */
+    const Ogre::StringVector& getDependencies() const { return mDependencies; }
+
 private:
-    bool _load(const char* name, Assimp::Importer& importer, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr, const Options& options);
-    bool createSubMesh(const Ogre::String& name, int index, const aiNode* pNode, const aiMesh *mesh, const aiMaterial* mat, Ogre::Mesh* mMesh, Ogre::AxisAlignedBox& mAAB);
+    struct SubMeshChunk;
+    struct VertexInfluences;
+    struct PreparedSubMesh;
+    struct MeshJob;
+    struct NodeBatch;
+    typedef std::tuple<int, int, int> GridCell;
+
+    bool _load(const char* name, Assimp::Importer& importer, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr,
+               const Options& options, Ogre::uint64 sourceHash);
+    bool _loadAnimations(const char* name, Assimp::Importer& importer, const Ogre::SkeletonPtr& skeleton, const Options& options);
+    bool reportProgress(LoadPhase phase, float progress);
+    void logIOStats(const Options& options) const;
+    void cancelLoad(Ogre::Mesh* mesh, unsigned short numSubMeshes, const Ogre::AxisAlignedBox& bounds, Ogre::Real radius);
+    void clearLoadState();
+    Ogre::MeshPtr createReimportMesh(const Ogre::Mesh* mesh);
+    void removeReimportMaterials();
+    void applyReimport(Ogre::Mesh* scratch, Ogre::SkeletonPtr& newSkeleton, Ogre::Mesh* mesh, Ogre::SkeletonPtr& skeletonPtr,
+                       ReimportResult& result);
+    void createSkeleton(const aiScene* mScene, const Ogre::String& name);
+    void appendBoneIdentity(const aiNode* pNode, std::map<Ogre::String, Ogre::uint16>& handles, Ogre::String& identity);
+    Ogre::String findSharedSkeleton(const aiScene* mScene, const Options& options);
+    static Ogre::uint32 getPostProcessFlags(const Options& options, int& removeComponents);
+    static const aiScene* postProcessInParallel(Assimp::Importer& importer, const Options& options);
+    bool matchesFilter(const char* name, const Ogre::String& filter, const std::regex& regex) const;
+    static void splitMeshIntoChunks(const aiMesh* mesh, size_t maxVertices, std::vector<SubMeshChunk>& chunks);
+    static void splitChunkByCell(const SubMeshChunk& chunk, const aiMesh* mesh, const aiMatrix4x4& transform, Ogre::Real cellSize,
+                                 std::vector<SubMeshChunk>& chunks, std::vector<GridCell>& cells);
+    Chunk& getChunk(const GridCell& cell, Ogre::Mesh* mesh);
+    static void splitChunkByBones(const SubMeshChunk& chunk, const std::vector<VertexInfluences>& influences, size_t maxBones, std::vector<SubMeshChunk>& chunks);
+    void gatherBoneInfluences(const aiMesh *mesh, std::vector<VertexInfluences>& influences) const;
+    // prepare* run in parallel and must not touch Ogre managers or loader state, commit* run serially in node order
+    void prepareMeshJob(MeshJob& job) const;
+    void prepareSubMesh(const MeshJob& job, const SubMeshChunk& chunk, const std::vector<VertexInfluences>& influences, PreparedSubMesh& prepared) const;
+    bool commitMeshJob(const aiScene* mScene, MeshJob& job, Ogre::Mesh* mMesh, Ogre::AxisAlignedBox& mAAB);
+    void commitSubMesh(PreparedSubMesh& prepared, const Ogre::MaterialPtr& matptr, Ogre::Mesh* mMesh, Ogre::AxisAlignedBox& mAAB, Ogre::Real& radius);
     Ogre::MaterialPtr createMaterial(int index, const aiMaterial* mat);
     void grabNodeNamesFromNode(const aiScene* mScene,  const aiNode* pNode);
     void grabBoneNamesFromNode(const aiScene* mScene,  const aiNode* pNode);
     void computeNodesDerivedTransform(const aiScene* mScene,  const aiNode *pNode, const aiMatrix4x4 accTransform);
     void createBonesFromNode(const aiScene* mScene,  const aiNode* pNode);
     void createBoneHiearchy(const aiScene* mScene,  const aiNode *pNode);
-    void loadDataFromNode(const aiScene* mScene,  const aiNode *pNode, Ogre::Mesh* mesh);
+    void collectMeshJobs(const aiScene* mScene, const aiNode *pNode, bool nodeIncluded, std::vector<NodeBatch>& batches) const;
+    void loadMeshes(const aiScene* mScene, Ogre::Mesh* mesh);
     void markAllChildNodesAsNeeded(const aiNode *pNode);
+    void pruneUnusedBones(const aiScene* mScene);
     void flagNodeAsNeeded(const char* name);
     bool isNodeNeeded(const char* name);
     void parseAnimation (const aiScene* mScene, int index, aiAnimation* anim);
-    typedef std::map<Ogre::String, bool> boneMapType;
+
+    /// the entry for key, inserted with a copy of key in the arena if missing
+    template <typename Map> typename Map::mapped_type& arenaEntry(Map& map, const char* key)
+    {
+        typename Map::iterator it = map.find(key);
+        if (it == map.end())
+            it = map.emplace(mArena.intern(key), typename Map::mapped_type()).first;
+        return it->second;
+    }
+
+    // backs the lookups below, they are keyed by names interned in it and cleared after every load
+    LoadArena mArena;
+
+    typedef ArenaMap<const char*, bool, CStringLess> boneMapType;
     boneMapType boneMap;
     //aiNode* mSkeletonRootNode;
     int mLoaderParams;
 
     Ogre::String mCustomAnimationName;
+    // channel name -> bone name while appending animations, null otherwise
+    const std::map<Ogre::String, Ogre::String>* mBoneNameMap;
+    // loadAnimations adds the clips to an existing skeleton
+    bool mAppendingAnimations;
 
-    typedef std::map<Ogre::String, const aiNode*> BoneNodeMap;
+    Ogre::String mNodeFilter;
+    Ogre::String mMeshFilter;
+    std::regex mNodeRegex;
+    std::regex mMeshRegex;
+
+    typedef ArenaMap<const char*, const aiNode*, CStringLess> BoneNodeMap;
     BoneNodeMap mBoneNodesByName;
 
-    typedef std::map<Ogre::String, const aiBone*> BoneMap;
+    typedef ArenaMap<const char*, const aiBone*, CStringLess> BoneMap;
     BoneMap mBonesByName;
 
-    typedef std::map<Ogre::String, aiMatrix4x4> NodeTransformMap;
+    typedef ArenaMap<const char*, aiMatrix4x4, CStringLess> NodeTransformMap;
     NodeTransformMap mNodeDerivedTransformByName;
 
+    // bones removed by pruneUnusedBones and the transforms folded into their children
+    ArenaSet<const char*, CStringLess> mPrunedBones;
+    NodeTransformMap mFoldedTransformByName;
+
     Ogre::SkeletonPtr mSkeleton;
+    bool mSkeletonShared; // mSkeleton was loaded before, do not modify or remove it
 
-    static int msBoneCount;
+    int mBoneCount; // handle of the next bone createSkeleton creates
 
     bool mQuietMode;
     Ogre::Real mTicksPerSecond;
     Ogre::Real mAnimationSpeedModifier;
+    unsigned short mMaxBoneInfluences;
+    unsigned short mMaxBonesPerSubMesh;
+    Ogre::VertexElementType mTangentType;
+    unsigned int mThreads;
+    Ogre::Real mChunkSize;
+
+    ProgressCallback mProgress;
+    // read by the prepare workers, so they stop early
+    std::atomic<bool> mCancelled;
+
+    Stats mStats;
+    IOStats mIOStats;
+
+    Ogre::Real mBoundingRadius;
+    TriangleBVH mBVH;
+    std::vector<TriangleBVH::Triangle> mBVHTriangles;
+
+    /// number of nodes still to visit referencing each mesh, for LP_LOW_MEMORY
+    std::vector<unsigned int> mMeshUseCount;
+
+    // content hash of every submesh of the main mesh, stored in its UserObjectBindings
+    std::vector<Ogre::uint64> mSubMeshHashes;
+    // reimport rewrites existing materials, each once, from a scratch material once the load succeeded
+    bool mUpdateMaterials;
+    std::map<Ogre::String, Ogre::MaterialPtr> mUpdatedMaterials;
+
+    std::vector<Chunk> mChunks;
+    std::map<GridCell, size_t> mChunkByCell;
+
+    Ogre::String mSourceDir;
+    Ogre::StringVector mDependencies;
 };
 
 #endif // __AssimpLoader_h__
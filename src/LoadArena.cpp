@@ -0,0 +1,116 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include "LoadArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+LoadArena::LoadArena(size_t blockSize)
+    : mUsed(0), mBlockSize(blockSize), mAllocations(0), mBytes(0), mHeapAllocations(0)
+{
+}
+
+LoadArena::~LoadArena()
+{
+    for (Block& block : mBlocks)
+        free(block.data);
+}
+
+void* LoadArena::allocate(size_t bytes, size_t alignment)
+{
+    mAllocations++;
+    mBytes += bytes;
+
+    if (!mBlocks.empty())
+    {
+        Block& block = mBlocks.back();
+        size_t offset = (reinterpret_cast<size_t>(block.data) + mUsed + alignment - 1) / alignment * alignment -
+                        reinterpret_cast<size_t>(block.data);
+        if (offset + bytes <= block.size)
+        {
+            mUsed = offset + bytes;
+            return block.data + offset;
+        }
+    }
+
+    // a new block grows with the arena, so the number of blocks stays logarithmic
+    size_t size = std::max(mBlockSize, bytes + alignment);
+    if (!mBlocks.empty())
+        size = std::max(size, mBlocks.back().size * 2);
+    Block block = {static_cast<char*>(malloc(size)), size};
+    if (!block.data)
+        throw std::bad_alloc();
+    mBlocks.push_back(block);
+    mHeapAllocations++;
+
+    size_t offset = (reinterpret_cast<size_t>(block.data) + alignment - 1) / alignment * alignment -
+                    reinterpret_cast<size_t>(block.data);
+    mUsed = offset + bytes;
+    return block.data + offset;
+}
+
+const char* LoadArena::intern(const char* str)
+{
+    size_t length = strlen(str) + 1;
+    char* copy = static_cast<char*>(allocate(length, 1));
+    memcpy(copy, str, length);
+    return copy;
+}
+
+void LoadArena::reset()
+{
+    // replace several blocks by one holding all of them, the next load of the same size fits into it
+    if (mBlocks.size() > 1)
+    {
+        size_t total = 0;
+        for (Block& block : mBlocks)
+        {
+            total += block.size;
+            free(block.data);
+        }
+        mBlocks.clear();
+
+        Block block = {static_cast<char*>(malloc(total)), total};
+        if (block.data)
+            mBlocks.push_back(block);
+    }
+
+    mUsed = 0;
+    mAllocations = 0;
+    mBytes = 0;
+    mHeapAllocations = 0;
+}
@@ -0,0 +1,121 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#ifndef __LoadArena_h__
+#define __LoadArena_h__
+
+#include <cstring>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+/** Monotonic memory for the transient data of a load
+
+    Hands out memory from large blocks and frees nothing until reset, which drops everything
+    at once. Reset keeps a single block big enough for everything the load used, so a loader
+    reused for similar files stops allocating from the heap. Not thread safe.
+*/
+class LoadArena
+{
+public:
+    explicit LoadArena(size_t blockSize = 64 * 1024);
+    ~LoadArena();
+
+    void* allocate(size_t bytes, size_t alignment);
+
+    /// copies the zero terminated str into the arena
+    const char* intern(const char* str);
+
+    void reset();
+
+    /// allocations served since the last reset
+    size_t getAllocations() const { return mAllocations; }
+    /// bytes handed out since the last reset
+    size_t getBytes() const { return mBytes; }
+    /// blocks taken from the heap since the last reset
+    size_t getHeapAllocations() const { return mHeapAllocations; }
+
+private:
+    LoadArena(const LoadArena&);
+    LoadArena& operator=(const LoadArena&);
+
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Block> mBlocks;
+    size_t mUsed; // bytes used in the last block
+    size_t mBlockSize;
+    size_t mAllocations;
+    size_t mBytes;
+    size_t mHeapAllocations;
+};
+
+/// standard allocator on top of a LoadArena, deallocation is a no-op
+template <typename T> class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(LoadArena& arena) : mArena(&arena) {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.mArena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U> bool operator==(const ArenaAllocator<U>& other) const { return mArena == other.mArena; }
+    template <typename U> bool operator!=(const ArenaAllocator<U>& other) const { return mArena != other.mArena; }
+
+private:
+    template <typename U> friend class ArenaAllocator;
+    LoadArena* mArena;
+};
+
+/// orders keys that point at zero terminated strings
+struct CStringLess
+{
+    bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+};
+
+template <typename K, typename V, typename Compare = std::less<K> >
+using ArenaMap = std::map<K, V, Compare, ArenaAllocator<std::pair<const K, V> > >;
+
+template <typename K, typename Compare = std::less<K> >
+using ArenaSet = std::set<K, Compare, ArenaAllocator<K> >;
+
+#endif // __LoadArena_h__
@@ -0,0 +1,312 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include "LogSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <OgreLogManager.h>
+#include <OgreStringConverter.h>
+
+struct LogSink::Ring
+{
+    static const size_t CAPACITY = 512; // slots, a power of two
+    static const size_t TEXT_SIZE = 240;
+
+    struct Slot
+    {
+        Level level;
+        const char* category;
+        bool summarised; // counted under category, no text
+        bool more;       // the message continues in the next slot
+        unsigned short length;
+        char text[TEXT_SIZE];
+    };
+
+    Slot slots[CAPACITY];
+    std::atomic<size_t> head; // slots written, only the owning thread advances it
+    std::atomic<size_t> tail; // slots drained, only the drainer advances it
+    std::atomic<bool> owned;  // a running thread writes to the ring
+
+    Ring() : head(0), tail(0), owned(true) {}
+};
+
+/// gives the ring of a thread back when the thread ends
+struct LogSink::ThreadRing
+{
+    Ring* ring;
+
+    ThreadRing() : ring(NULL) {}
+    ~ThreadRing()
+    {
+        if (ring)
+            ring->owned.store(false, std::memory_order_release);
+    }
+};
+
+LogSink& LogSink::getSingleton()
+{
+    static LogSink sink;
+    return sink;
+}
+
+LogSink::LogSink() : mVerbosity(LEVEL_TRACE), mSummarise(false), mStop(false) {}
+
+LogSink::~LogSink() { shutdown(); }
+
+void LogSink::shutdown()
+{
+    if (mStop)
+        return;
+    flush();
+
+    {
+        // registering a ring starts the drainer, so none starts after this
+        std::lock_guard<std::mutex> lock(mRingsMutex);
+        mStop = true;
+    }
+    mWake.notify_one();
+    if (mDrainer.joinable())
+        mDrainer.join();
+    mDrained.notify_all();
+}
+
+LogSink::Ring* LogSink::getThreadRing()
+{
+    static thread_local ThreadRing threadRing;
+    if (threadRing.ring)
+        return threadRing.ring;
+
+    std::lock_guard<std::mutex> lock(mRingsMutex);
+    // the ring of an ended thread still holds its messages, which stay in order before ours
+    for (const std::unique_ptr<Ring>& ring : mRings)
+    {
+        if (!ring->owned.load(std::memory_order_acquire))
+        {
+            ring->owned.store(true, std::memory_order_relaxed);
+            threadRing.ring = ring.get();
+            break;
+        }
+    }
+    if (!threadRing.ring)
+    {
+        mRings.emplace_back(new Ring());
+        threadRing.ring = mRings.back().get();
+    }
+
+    if (!mDrainer.joinable() && !mStop)
+        mDrainer = std::thread(&LogSink::drainLoop, this);
+    return threadRing.ring;
+}
+
+void LogSink::log(Level level, const char* category, const char* format, ...)
+{
+    if (!isEnabled(level) || mStop)
+        return;
+
+    Ring* ring = getThreadRing();
+    if (category && getSummarise())
+    {
+        push(ring, level, category, NULL, 0);
+        return;
+    }
+
+    char buffer[1024];
+    va_list args;
+    va_start(args, format);
+    va_list retry;
+    va_copy(retry, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length >= int(sizeof(buffer)))
+    {
+        std::vector<char> longBuffer(length + 1);
+        vsnprintf(longBuffer.data(), longBuffer.size(), format, retry);
+        push(ring, level, category, longBuffer.data(), length);
+    }
+    else if (length >= 0)
+    {
+        push(ring, level, category, buffer, length);
+    }
+    va_end(retry);
+}
+
+void LogSink::push(Ring* ring, Level level, const char* category, const char* text, size_t length)
+{
+    // longer messages are cut to what fits the ring
+    size_t count = std::max<size_t>(1, (length + Ring::TEXT_SIZE - 1) / Ring::TEXT_SIZE);
+    count = std::min(count, Ring::CAPACITY);
+
+    const size_t head = ring->head.load(std::memory_order_relaxed);
+    while (head + count - ring->tail.load(std::memory_order_acquire) > Ring::CAPACITY)
+    {
+        if (mStop)
+            return;
+        mWake.notify_one();
+        std::this_thread::yield();
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        Ring::Slot& slot = ring->slots[(head + i) & (Ring::CAPACITY - 1)];
+        slot.level = level;
+        slot.category = category;
+        slot.summarised = text == NULL;
+        slot.more = i + 1 < count;
+        slot.length = (unsigned short)std::min(length - std::min(length, i * Ring::TEXT_SIZE), Ring::TEXT_SIZE);
+        if (slot.length)
+            memcpy(slot.text, text + i * Ring::TEXT_SIZE, slot.length);
+    }
+    ring->head.store(head + count, std::memory_order_release);
+
+    // the drainer polls, a filling ring wakes it early
+    if (head + count - ring->tail.load(std::memory_order_relaxed) > Ring::CAPACITY / 2)
+        mWake.notify_one();
+}
+
+bool LogSink::drain(Ring* ring)
+{
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    const size_t head = ring->head.load(std::memory_order_acquire);
+    if (tail == head)
+        return false;
+
+    Ogre::LogManager* logMgr = Ogre::LogManager::getSingletonPtr();
+    std::map<const char*, size_t> counts;
+    Ogre::String message;
+    for (; tail != head; ++tail)
+    {
+        const Ring::Slot& slot = ring->slots[tail & (Ring::CAPACITY - 1)];
+        if (slot.summarised)
+        {
+            counts[slot.category]++;
+            continue;
+        }
+
+        message.append(slot.text, slot.length);
+        if (slot.more)
+            continue;
+
+        // Assimp ends its messages with a line break
+        message.erase(message.find_last_not_of(" \t\r\n") + 1);
+        if (logMgr)
+            logMgr->logMessage(message, slot.level == LEVEL_ERROR ? Ogre::LML_CRITICAL : Ogre::LML_NORMAL);
+        message.clear();
+    }
+    ring->tail.store(tail, std::memory_order_release);
+
+    if (!counts.empty())
+    {
+        std::lock_guard<std::mutex> lock(mSummaryMutex);
+        for (const auto& count : counts)
+            mSummaries[count.first] += count.second;
+    }
+    return true;
+}
+
+void LogSink::drainLoop()
+{
+    for (;;)
+    {
+        // read before draining, so the last messages are drained after a stop
+        const bool stop = mStop;
+
+        // rings are never freed, so they are drained without blocking threads registering theirs
+        std::vector<Ring*> rings;
+        {
+            std::lock_guard<std::mutex> lock(mRingsMutex);
+            for (const std::unique_ptr<Ring>& ring : mRings)
+                rings.push_back(ring.get());
+        }
+        bool drained = false;
+        for (Ring* ring : rings)
+            drained |= drain(ring);
+
+        if (drained)
+        {
+            std::lock_guard<std::mutex> lock(mDrainedMutex);
+            mDrained.notify_all();
+        }
+        if (stop)
+            break;
+        if (!drained)
+        {
+            std::unique_lock<std::mutex> lock(mWakeMutex);
+            mWake.wait_for(lock, std::chrono::milliseconds(2));
+        }
+    }
+}
+
+void LogSink::flush()
+{
+    std::vector<std::pair<Ring*, size_t> > pending;
+    {
+        std::lock_guard<std::mutex> lock(mRingsMutex);
+        for (const std::unique_ptr<Ring>& ring : mRings)
+            pending.push_back(std::make_pair(ring.get(), ring->head.load(std::memory_order_acquire)));
+    }
+
+    for (const auto& ring : pending)
+    {
+        std::unique_lock<std::mutex> lock(mDrainedMutex);
+        if (ring.first->tail.load(std::memory_order_acquire) < ring.second)
+            mWake.notify_one();
+        mDrained.wait(lock, [&ring, this]() {
+            return ring.first->tail.load(std::memory_order_acquire) >= ring.second || mStop;
+        });
+    }
+
+    std::map<const char*, size_t> summaries;
+    {
+        std::lock_guard<std::mutex> lock(mSummaryMutex);
+        summaries.swap(mSummaries);
+    }
+
+    Ogre::LogManager* logMgr = Ogre::LogManager::getSingletonPtr();
+    if (!logMgr)
+        return;
+
+    // the same literal may have several addresses, one per translation unit
+    std::map<Ogre::String, size_t> byName;
+    for (const auto& summary : summaries)
+        byName[summary.first] += summary.second;
+    for (const auto& summary : byName)
+        logMgr->logMessage(Ogre::StringConverter::toString(summary.second) + " " + summary.first + " messages summarised");
+}
@@ -0,0 +1,140 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#ifndef __LogSink_h__
+#define __LogSink_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Asynchronous sink for the verbose messages of loads
+
+    Every thread writing messages gets its own ring buffer, so writers never take a lock or wait
+    for Ogre::LogManager. A background thread drains the rings into the default log. Messages above
+    the verbosity are dropped before they are formatted when written with LOGSINK_LOG. With
+    summarising on, messages with a category are counted instead of written and flush writes one
+    line per category. Messages of one thread keep their order, those of different threads interleave.
+*/
+class LogSink
+{
+public:
+    enum Level
+    {
+        LEVEL_ERROR,  // failures
+        LEVEL_INFO,   // once per load
+        LEVEL_DETAIL, // once per material, animation or Assimp step
+        LEVEL_TRACE   // once per node, bone, channel or submesh
+    };
+
+    static LogSink& getSingleton();
+
+    /// messages above level are dropped, LEVEL_TRACE by default
+    void setVerbosity(Level level) { mVerbosity.store(level, std::memory_order_relaxed); }
+    Level getVerbosity() const { return Level(mVerbosity.load(std::memory_order_relaxed)); }
+    bool isEnabled(Level level) const { return level <= mVerbosity.load(std::memory_order_relaxed); }
+
+    /// count messages with a category instead of writing them, off by default
+    void setSummarise(bool summarise) { mSummarise.store(summarise, std::memory_order_relaxed); }
+    bool getSummarise() const { return mSummarise.load(std::memory_order_relaxed); }
+
+    /** queues a printf formatted message
+
+        @param category string literal naming a kind of repetitive message, e.g. "bone", or NULL.
+        Messages of a category are not formatted at all when summarising.
+    */
+    void log(Level level, const char* category, const char* format, ...)
+#ifdef __GNUC__
+        __attribute__((format(printf, 4, 5)))
+#endif
+        ;
+
+    /// waits until the messages queued so far are written, then writes the summaries
+    void flush();
+
+    /** flushes and stops the background thread, later messages are dropped
+
+        Call it before deleting the Ogre::LogManager, which the background thread writes to.
+    */
+    void shutdown();
+
+    ~LogSink();
+
+private:
+    LogSink();
+    LogSink(const LogSink&);
+    LogSink& operator=(const LogSink&);
+
+    struct Ring;
+    struct ThreadRing;
+
+    Ring* getThreadRing();
+    void push(Ring* ring, Level level, const char* category, const char* text, size_t length);
+    bool drain(Ring* ring);
+    void drainLoop();
+
+    std::atomic<int> mVerbosity;
+    std::atomic<bool> mSummarise;
+
+    // registration of the rings, only taken when a thread writes its first message
+    std::mutex mRingsMutex;
+    std::vector<std::unique_ptr<Ring> > mRings;
+
+    // written by the drainer, read by flush
+    std::mutex mSummaryMutex;
+    std::map<const char*, size_t> mSummaries;
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    // signalled by the drainer after every pass, flush waits on it
+    std::mutex mDrainedMutex;
+    std::condition_variable mDrained;
+    std::atomic<bool> mStop;
+    std::thread mDrainer;
+};
+
+/// queues the message only if level is enabled, the arguments are not evaluated otherwise
+#define LOGSINK_LOG(level, category, ...)                                                                            \
+    do                                                                                                                \
+    {                                                                                                                 \
+        if (LogSink::getSingleton().isEnabled(level))                                                                 \
+            LogSink::getSingleton().log(level, category, __VA_ARGS__);                                               \
+    } while (0)
+
+#endif // __LogSink_h__
@@ -0,0 +1,609 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include "MeshBlobSerializer.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include <Ogre.h>
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const Ogre::uint32 BLOB_MAGIC = 0x424C4D4F; // "OMLB"
+const Ogre::uint32 BLOB_VERSION = 2;
+const Ogre::uint32 BYTE_ORDER_MARK = 0x01020304; // reads as 0x04030201 with the other byte order
+const size_t BLOB_ALIGNMENT = 16;
+const Ogre::uint32 NO_INDEX = 0xFFFFFFFF;
+
+struct Header
+{
+    Ogre::uint32 magic;
+    Ogre::uint32 version;
+    Ogre::uint64 hash; // of everything after the header
+    Ogre::uint64 size; // of the whole blob
+    Ogre::uint32 subMeshCount;
+    Ogre::uint32 vertexDataCount;
+    Ogre::uint32 sharedVertexData; // index into the vertex data table or NO_INDEX
+    Ogre::uint32 skeletonName;     // offset into the string table or NO_INDEX
+    Ogre::uint64 subMeshOffset;
+    Ogre::uint64 vertexDataOffset;
+    Ogre::uint64 stringOffset;
+    float bounds[6]; // inverted for a null box
+    float radius;
+    Ogre::uint32 byteOrder; // BYTE_ORDER_MARK as written by the exporting machine
+};
+
+struct SubMeshEntry
+{
+    Ogre::uint32 name;       // offset into the string table
+    Ogre::uint32 material;   // offset into the string table
+    Ogre::uint32 vertexData; // index into the vertex data table
+    Ogre::uint32 operationType;
+    Ogre::uint32 indexSize;  // 2 or 4 bytes, 0 without index buffer
+    Ogre::uint32 indexCount;
+    Ogre::uint64 indexOffset;
+    Ogre::uint32 boneMapCount;
+    Ogre::uint32 padding;
+    Ogre::uint64 boneMapOffset; // uint16 bone index per blend index
+};
+
+struct VertexDataEntry
+{
+    Ogre::uint32 vertexStart;
+    Ogre::uint32 vertexCount;
+    Ogre::uint32 elementCount;
+    Ogre::uint32 bufferCount;
+    Ogre::uint64 elementOffset;
+    Ogre::uint64 bufferOffset;
+};
+
+struct ElementEntry
+{
+    Ogre::uint16 source;
+    Ogre::uint16 index;
+    Ogre::uint32 offset;
+    Ogre::uint32 type;
+    Ogre::uint32 semantic;
+};
+
+struct BufferEntry
+{
+    Ogre::uint16 source;
+    Ogre::uint16 padding;
+    Ogre::uint32 vertexSize;
+    Ogre::uint32 vertexCount;
+    Ogre::uint32 padding2;
+    Ogre::uint64 offset;
+};
+
+static_assert(sizeof(Header) == 96 && sizeof(SubMeshEntry) == 48 && sizeof(VertexDataEntry) == 32 &&
+              sizeof(ElementEntry) == 16 && sizeof(BufferEntry) == 24, "blob layout must not depend on the compiler");
+
+/// grows the blob in aligned blocks, addressed by offset as the storage moves
+class BlobWriter
+{
+public:
+    size_t reserve(size_t bytes)
+    {
+        size_t at = (mData.size() + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+        mData.resize(at + bytes);
+        return at;
+    }
+
+    size_t append(const void* data, size_t bytes)
+    {
+        size_t at = reserve(bytes);
+        if (bytes)
+            memcpy(&mData[at], data, bytes);
+        return at;
+    }
+
+    template <typename T> T* at(size_t offset) { return reinterpret_cast<T*>(&mData[offset]); }
+
+    std::vector<Ogre::uint8>& data() { return mData; }
+
+private:
+    std::vector<Ogre::uint8> mData;
+};
+
+class StringTable
+{
+public:
+    Ogre::uint32 add(const Ogre::String& str)
+    {
+        std::map<Ogre::String, Ogre::uint32>::iterator it = mOffsets.find(str);
+        if (it != mOffsets.end())
+            return it->second;
+
+        Ogre::uint32 offset = Ogre::uint32(mData.size());
+        mData.insert(mData.end(), str.begin(), str.end());
+        mData.push_back(0);
+        mOffsets[str] = offset;
+        return offset;
+    }
+
+    const std::vector<char>& data() const { return mData; }
+
+private:
+    std::vector<char> mData;
+    std::map<Ogre::String, Ogre::uint32> mOffsets;
+};
+
+/// bounds checked access to an untrusted blob
+class BlobReader
+{
+public:
+    BlobReader(const void* data, size_t size) : mData(static_cast<const Ogre::uint8*>(data)), mSize(size) {}
+
+    template <typename T> const T* at(Ogre::uint64 offset, Ogre::uint64 count = 1) const
+    {
+        if (offset > mSize || count > (mSize - offset) / sizeof(T))
+        {
+            OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "mesh blob is truncated", "MeshBlobSerializer::importMesh");
+        }
+        return reinterpret_cast<const T*>(mData + offset);
+    }
+
+    Ogre::String string(Ogre::uint64 stringOffset, Ogre::uint32 offset) const
+    {
+        const char* str = at<char>(stringOffset + offset);
+        if (!memchr(str, 0, mSize - (stringOffset + offset)))
+        {
+            OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "mesh blob is truncated", "MeshBlobSerializer::importMesh");
+        }
+        return str;
+    }
+
+private:
+    const Ogre::uint8* mData;
+    size_t mSize;
+};
+
+void throwInvalid(const Ogre::String& meshName, const Ogre::String& what)
+{
+    OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "mesh blob of '" + meshName + "' has " + what, "MeshBlobSerializer::importMesh");
+}
+
+/// checks every table before anything is created, a rejected blob leaves the mesh untouched
+void validateBlob(const BlobReader& blob, const Header& header, const Ogre::String& meshName)
+{
+    const VertexDataEntry* vertexDataEntries = blob.at<VertexDataEntry>(header.vertexDataOffset, header.vertexDataCount);
+    for (Ogre::uint32 i = 0; i < header.vertexDataCount; ++i)
+    {
+        const VertexDataEntry& entry = vertexDataEntries[i];
+        const BufferEntry* buffers = blob.at<BufferEntry>(entry.bufferOffset, entry.bufferCount);
+        for (Ogre::uint32 b = 0; b < entry.bufferCount; ++b)
+        {
+            if (Ogre::uint64(entry.vertexStart) + entry.vertexCount > buffers[b].vertexCount)
+                throwInvalid(meshName, "a vertex range outside its buffers");
+            blob.at<Ogre::uint8>(buffers[b].offset, Ogre::uint64(buffers[b].vertexSize) * buffers[b].vertexCount);
+        }
+
+        const ElementEntry* elements = blob.at<ElementEntry>(entry.elementOffset, entry.elementCount);
+        for (Ogre::uint32 e = 0; e < entry.elementCount; ++e)
+        {
+            const ElementEntry& element = elements[e];
+            if (element.semantic < Ogre::VES_POSITION || element.semantic > Ogre::VES_TANGENT)
+                throwInvalid(meshName, "an invalid vertex element semantic");
+            // unknown types have no size
+            size_t typeSize = element.type <= 0xFF ? Ogre::VertexElement::getTypeSize(Ogre::VertexElementType(element.type)) : 0;
+            if (!typeSize)
+                throwInvalid(meshName, "an invalid vertex element type");
+
+            const BufferEntry* buffer = NULL;
+            for (Ogre::uint32 b = 0; b < entry.bufferCount && !buffer; ++b)
+            {
+                if (buffers[b].source == element.source)
+                    buffer = &buffers[b];
+            }
+            if (!buffer)
+                throwInvalid(meshName, "a vertex element without buffer");
+            if (Ogre::uint64(element.offset) + typeSize > buffer->vertexSize)
+                throwInvalid(meshName, "a vertex element outside its vertex");
+        }
+    }
+
+    // every vertex data has a single owner
+    std::vector<bool> owned(header.vertexDataCount, false);
+    auto claimVertexData = [&](Ogre::uint32 index) {
+        if (index >= owned.size() || owned[index])
+            throwInvalid(meshName, "an invalid vertex data index");
+        owned[index] = true;
+    };
+
+    if (header.sharedVertexData != NO_INDEX)
+        claimVertexData(header.sharedVertexData);
+
+    const SubMeshEntry* subMeshEntries = blob.at<SubMeshEntry>(header.subMeshOffset, header.subMeshCount);
+    for (Ogre::uint32 i = 0; i < header.subMeshCount; ++i)
+    {
+        const SubMeshEntry& entry = subMeshEntries[i];
+        blob.string(header.stringOffset, entry.name);
+        blob.string(header.stringOffset, entry.material);
+        if (entry.vertexData == NO_INDEX || entry.vertexData != header.sharedVertexData)
+            claimVertexData(entry.vertexData);
+        if (entry.operationType < Ogre::RenderOperation::OT_POINT_LIST || entry.operationType > Ogre::RenderOperation::OT_TRIANGLE_FAN)
+            throwInvalid(meshName, "an invalid operation type");
+        if (entry.indexCount)
+        {
+            if (entry.indexSize != 2 && entry.indexSize != 4)
+                throwInvalid(meshName, "an invalid index size");
+            blob.at<Ogre::uint8>(entry.indexOffset, Ogre::uint64(entry.indexSize) * entry.indexCount);
+        }
+        blob.at<Ogre::uint16>(entry.boneMapOffset, entry.boneMapCount);
+    }
+
+    if (header.skeletonName != NO_INDEX)
+        blob.string(header.stringOffset, header.skeletonName);
+}
+
+/// read only view of a whole file
+class MappedFile
+{
+public:
+    MappedFile(const Ogre::String& filename) : mData(NULL), mSize(0)
+    {
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+        mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        mMapping = NULL;
+        LARGE_INTEGER size;
+        if (mFile != INVALID_HANDLE_VALUE && GetFileSizeEx(mFile, &size) && size.QuadPart)
+        {
+            mSize = size_t(size.QuadPart);
+            mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mMapping)
+                mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+        }
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size)
+        {
+            mSize = size_t(st.st_size);
+            mData = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mData == MAP_FAILED)
+                mData = NULL;
+        }
+        if (fd >= 0)
+            close(fd);
+#endif
+        if (!mData)
+        {
+            OGRE_EXCEPT(Ogre::Exception::ERR_FILE_NOT_FOUND, "Unable to map file " + filename, "MeshBlobSerializer::importMesh");
+        }
+    }
+
+    ~MappedFile()
+    {
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+        if (mData)
+            UnmapViewOfFile(mData);
+        if (mMapping)
+            CloseHandle(mMapping);
+        if (mFile != INVALID_HANDLE_VALUE)
+            CloseHandle(mFile);
+#else
+        if (mData)
+            munmap(mData, mSize);
+#endif
+    }
+
+    const void* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    void* mData;
+    size_t mSize;
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+    HANDLE mFile;
+    HANDLE mMapping;
+#endif
+};
+} // namespace
+
+Ogre::uint64 MeshBlobSerializer::hash(const void* data, size_t size, Ogre::uint64 seed)
+{
+    const Ogre::uint8* bytes = static_cast<const Ogre::uint8*>(data);
+    Ogre::uint64 h = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= bytes[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void MeshBlobSerializer::exportMesh(Ogre::Mesh* mesh, const Ogre::String& filename)
+{
+    // store blend indices and weights in the vertex buffers
+    mesh->_compileBoneAssignments();
+
+    std::vector<const Ogre::VertexData*> vertexDatas;
+    Ogre::uint32 shared = NO_INDEX;
+    if (mesh->sharedVertexData)
+    {
+        shared = 0;
+        vertexDatas.push_back(mesh->sharedVertexData);
+    }
+    for (const Ogre::SubMesh* sm : mesh->getSubMeshes())
+    {
+        if (!sm->useSharedVertices)
+            vertexDatas.push_back(sm->vertexData);
+    }
+
+    std::vector<Ogre::String> subMeshNames(mesh->getNumSubMeshes());
+    for (const auto& entry : mesh->getSubMeshNameMap())
+        subMeshNames[entry.second] = entry.first;
+
+    BlobWriter blob;
+    StringTable strings;
+    size_t headerAt = blob.reserve(sizeof(Header));
+    size_t subMeshAt = blob.reserve(mesh->getNumSubMeshes() * sizeof(SubMeshEntry));
+    size_t vertexDataAt = blob.reserve(vertexDatas.size() * sizeof(VertexDataEntry));
+
+    for (size_t i = 0; i < vertexDatas.size(); ++i)
+    {
+        const Ogre::VertexData* vd = vertexDatas[i];
+        const Ogre::VertexDeclaration::VertexElementList& elements = vd->vertexDeclaration->getElements();
+        const Ogre::VertexBufferBinding::VertexBufferBindingMap& bindings = vd->vertexBufferBinding->getBindings();
+
+        size_t elementAt = blob.reserve(elements.size() * sizeof(ElementEntry));
+        size_t bufferAt = blob.reserve(bindings.size() * sizeof(BufferEntry));
+
+        VertexDataEntry* entry = blob.at<VertexDataEntry>(vertexDataAt + i * sizeof(VertexDataEntry));
+        entry->vertexStart = Ogre::uint32(vd->vertexStart);
+        entry->vertexCount = Ogre::uint32(vd->vertexCount);
+        entry->elementCount = Ogre::uint32(elements.size());
+        entry->bufferCount = Ogre::uint32(bindings.size());
+        entry->elementOffset = elementAt;
+        entry->bufferOffset = bufferAt;
+
+        ElementEntry* element = blob.at<ElementEntry>(elementAt);
+        for (const Ogre::VertexElement& e : elements)
+        {
+            element->source = e.getSource();
+            element->index = e.getIndex();
+            element->offset = Ogre::uint32(e.getOffset());
+            element->type = e.getType();
+            element->semantic = e.getSemantic();
+            element++;
+        }
+
+        size_t b = 0;
+        for (const auto& binding : bindings)
+        {
+            const Ogre::HardwareVertexBufferSharedPtr& vbuf = binding.second;
+            size_t bytes = vbuf->getVertexSize() * vbuf->getNumVertices();
+            size_t payloadAt = blob.append(vbuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY), bytes);
+            vbuf->unlock();
+
+            BufferEntry* buffer = blob.at<BufferEntry>(bufferAt + b++ * sizeof(BufferEntry));
+            buffer->source = binding.first;
+            buffer->vertexSize = Ogre::uint32(vbuf->getVertexSize());
+            buffer->vertexCount = Ogre::uint32(vbuf->getNumVertices());
+            buffer->offset = payloadAt;
+        }
+    }
+
+    Ogre::uint32 ownVertexData = shared == NO_INDEX ? 0 : 1;
+    for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+    {
+        Ogre::SubMesh* sm = mesh->getSubMesh(i);
+        SubMeshEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.name = strings.add(subMeshNames[i]);
+        entry.material = strings.add(sm->getMaterialName());
+        entry.vertexData = sm->useSharedVertices ? shared : ownVertexData++;
+        entry.operationType = sm->operationType;
+
+        const Ogre::HardwareIndexBufferSharedPtr& ibuf = sm->indexData->indexBuffer;
+        if (ibuf && sm->indexData->indexCount)
+        {
+            entry.indexSize = Ogre::uint32(ibuf->getIndexSize());
+            entry.indexCount = Ogre::uint32(sm->indexData->indexCount);
+            size_t bytes = entry.indexSize * entry.indexCount;
+            entry.indexOffset = blob.append(ibuf->lock(sm->indexData->indexStart * entry.indexSize, bytes,
+                                                       Ogre::HardwareBuffer::HBL_READ_ONLY), bytes);
+            ibuf->unlock();
+        }
+
+        const Ogre::SubMesh::IndexMap& boneMap = sm->useSharedVertices ? mesh->sharedBlendIndexToBoneIndexMap : sm->blendIndexToBoneIndexMap;
+        entry.boneMapCount = Ogre::uint32(boneMap.size());
+        entry.boneMapOffset = blob.append(boneMap.data(), boneMap.size() * sizeof(Ogre::uint16));
+
+        *blob.at<SubMeshEntry>(subMeshAt + i * sizeof(SubMeshEntry)) = entry;
+    }
+
+    Ogre::uint32 skeletonName = mesh->hasSkeleton() ? strings.add(mesh->getSkeletonName()) : NO_INDEX;
+    size_t stringAt = blob.append(strings.data().data(), strings.data().size());
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BLOB_MAGIC;
+    header.version = BLOB_VERSION;
+    header.size = blob.data().size();
+    header.subMeshCount = mesh->getNumSubMeshes();
+    header.vertexDataCount = Ogre::uint32(vertexDatas.size());
+    header.sharedVertexData = shared;
+    header.skeletonName = skeletonName;
+    header.subMeshOffset = subMeshAt;
+    header.vertexDataOffset = vertexDataAt;
+    header.stringOffset = stringAt;
+    const Ogre::AxisAlignedBox& bounds = mesh->getBounds();
+    for (int a = 0; a < 3; ++a)
+    {
+        header.bounds[a] = bounds.isNull() ? 1.0f : float(bounds.getMinimum()[a]);
+        header.bounds[a + 3] = bounds.isNull() ? -1.0f : float(bounds.getMaximum()[a]);
+    }
+    header.radius = mesh->getBoundingSphereRadius();
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.hash = hash(&blob.data()[sizeof(Header)], blob.data().size() - sizeof(Header));
+    *blob.at<Header>(headerAt) = header;
+
+    std::ofstream ofs(filename.c_str(), std::ios::binary);
+    if (!ofs)
+    {
+        OGRE_EXCEPT(Ogre::Exception::ERR_CANNOT_WRITE_TO_FILE, "Unable to open file " + filename + " for writing",
+                    "MeshBlobSerializer::exportMesh");
+    }
+    ofs.write(reinterpret_cast<const char*>(blob.data().data()), blob.data().size());
+}
+
+void MeshBlobSerializer::importMesh(const void* data, size_t size, Ogre::Mesh* mesh, bool verify)
+{
+    BlobReader blob(data, size);
+    const Header& header = *blob.at<Header>(0);
+    if (header.byteOrder == Ogre::Bitwise::bswap32(BYTE_ORDER_MARK))
+    {
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "mesh blob of '" + mesh->getName() + "' has the wrong byte order",
+                    "MeshBlobSerializer::importMesh");
+    }
+    if (header.magic != BLOB_MAGIC || header.version != BLOB_VERSION || header.byteOrder != BYTE_ORDER_MARK)
+    {
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "'" + mesh->getName() + "' is not a supported mesh blob",
+                    "MeshBlobSerializer::importMesh");
+    }
+    if (verify && (header.size != size ||
+                   header.hash != hash(static_cast<const Ogre::uint8*>(data) + sizeof(Header), size - sizeof(Header))))
+    {
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "mesh blob of '" + mesh->getName() + "' is corrupt",
+                    "MeshBlobSerializer::importMesh");
+    }
+
+    validateBlob(blob, header, mesh->getName());
+
+    Ogre::HardwareBufferManager& hbm = Ogre::HardwareBufferManager::getSingleton();
+
+    const VertexDataEntry* vertexDataEntries = blob.at<VertexDataEntry>(header.vertexDataOffset, header.vertexDataCount);
+    // owned here until the mesh or a submesh takes them, the rest is freed on return
+    std::vector<std::unique_ptr<Ogre::VertexData> > vertexDatas;
+    for (Ogre::uint32 i = 0; i < header.vertexDataCount; ++i)
+    {
+        const VertexDataEntry& entry = vertexDataEntries[i];
+        vertexDatas.emplace_back(new Ogre::VertexData());
+        Ogre::VertexData* vd = vertexDatas.back().get();
+        vd->vertexStart = entry.vertexStart;
+        vd->vertexCount = entry.vertexCount;
+
+        const ElementEntry* elements = blob.at<ElementEntry>(entry.elementOffset, entry.elementCount);
+        for (Ogre::uint32 e = 0; e < entry.elementCount; ++e)
+        {
+            vd->vertexDeclaration->addElement(elements[e].source, elements[e].offset,
+                                              Ogre::VertexElementType(elements[e].type),
+                                              Ogre::VertexElementSemantic(elements[e].semantic), elements[e].index);
+        }
+
+        // the payload is the buffer content, upload it as is
+        const BufferEntry* buffers = blob.at<BufferEntry>(entry.bufferOffset, entry.bufferCount);
+        for (Ogre::uint32 b = 0; b < entry.bufferCount; ++b)
+        {
+            Ogre::HardwareVertexBufferSharedPtr vbuf = hbm.createVertexBuffer(buffers[b].vertexSize, buffers[b].vertexCount,
+                                                                              Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            size_t bytes = size_t(buffers[b].vertexSize) * buffers[b].vertexCount;
+            vbuf->writeData(0, bytes, blob.at<Ogre::uint8>(buffers[b].offset, bytes), true);
+            vd->vertexBufferBinding->setBinding(buffers[b].source, vbuf);
+        }
+    }
+
+    if (header.sharedVertexData != NO_INDEX)
+        mesh->sharedVertexData = vertexDatas[header.sharedVertexData].release();
+
+    const SubMeshEntry* subMeshEntries = blob.at<SubMeshEntry>(header.subMeshOffset, header.subMeshCount);
+    for (Ogre::uint32 i = 0; i < header.subMeshCount; ++i)
+    {
+        const SubMeshEntry& entry = subMeshEntries[i];
+        Ogre::String name = blob.string(header.stringOffset, entry.name);
+        Ogre::SubMesh* sm = name.empty() ? mesh->createSubMesh() : mesh->createSubMesh(name);
+
+        sm->useSharedVertices = entry.vertexData != NO_INDEX && entry.vertexData == header.sharedVertexData;
+        if (!sm->useSharedVertices)
+            sm->vertexData = vertexDatas[entry.vertexData].release();
+        sm->operationType = Ogre::RenderOperation::OperationType(entry.operationType);
+
+        Ogre::String material = blob.string(header.stringOffset, entry.material);
+        if (!material.empty())
+            sm->setMaterialName(material, mesh->getGroup());
+
+        if (entry.indexCount)
+        {
+            Ogre::HardwareIndexBuffer::IndexType type = entry.indexSize == 4 ? Ogre::HardwareIndexBuffer::IT_32BIT : Ogre::HardwareIndexBuffer::IT_16BIT;
+            sm->indexData->indexBuffer = hbm.createIndexBuffer(type, entry.indexCount, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            sm->indexData->indexStart = 0;
+            sm->indexData->indexCount = entry.indexCount;
+            size_t bytes = size_t(entry.indexSize) * entry.indexCount;
+            sm->indexData->indexBuffer->writeData(0, bytes, blob.at<Ogre::uint8>(entry.indexOffset, bytes), true);
+        }
+
+        const Ogre::uint16* boneMap = blob.at<Ogre::uint16>(entry.boneMapOffset, entry.boneMapCount);
+        Ogre::SubMesh::IndexMap& indexMap = sm->useSharedVertices ? mesh->sharedBlendIndexToBoneIndexMap : sm->blendIndexToBoneIndexMap;
+        indexMap.assign(boneMap, boneMap + entry.boneMapCount);
+    }
+
+    if (header.skeletonName != NO_INDEX)
+        mesh->setSkeletonName(blob.string(header.stringOffset, header.skeletonName));
+
+    Ogre::AxisAlignedBox bounds;
+    if (header.bounds[0] <= header.bounds[3])
+    {
+        bounds.setExtents(Ogre::Vector3(header.bounds[0], header.bounds[1], header.bounds[2]),
+                          Ogre::Vector3(header.bounds[3], header.bounds[4], header.bounds[5]));
+    }
+    mesh->_setBounds(bounds, false);
+    mesh->_setBoundingSphereRadius(header.radius);
+}
+
+void MeshBlobSerializer::importMesh(const Ogre::String& filename, Ogre::Mesh* mesh, bool verify)
+{
+    MappedFile file(filename);
+    importMesh(file.data(), file.size(), mesh, verify);
+}
+
+void MeshBlobSerializer::importMesh(const Ogre::DataStreamPtr& stream, Ogre::Mesh* mesh, bool verify)
+{
+    Ogre::MemoryDataStream buffer(stream);
+    importMesh(buffer.getPtr(), buffer.size(), mesh, verify);
+}
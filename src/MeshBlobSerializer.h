@@ -0,0 +1,79 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#ifndef __MeshBlobSerializer_h__
+#define __MeshBlobSerializer_h__
+
+#include <OgrePrerequisites.h>
+
+/** Baked mesh format that is loaded without parsing
+
+    A blob in the byte order of the exporting machine, which the header records, so it only loads on
+    machines of the same byte order. It is laid out as
+    - header with the size of the blob and a FNV-1a hash of everything after the header
+    - submesh table: names, material, index type and count, offsets of the index and bone palette payloads
+    - vertex data table: vertex counts, offsets of the element and buffer tables
+    - element and buffer tables, mirroring VertexDeclaration and VertexBufferBinding
+    - string table
+    - vertex, index and bone palette payloads, each aligned to 16 bytes
+
+    The payloads are the hardware buffer contents, so they are uploaded with a single write each,
+    straight from a mapped file. Bone assignments are stored compiled, as blend index/weight elements
+    plus the blend index to bone index map. The format is not meant for interchange, rebuild it from
+    the source asset when Ogre or the loader changes.
+*/
+class MeshBlobSerializer
+{
+public:
+    /// compiles the bone assignments of mesh if needed and writes it to filename
+    static void exportMesh(Ogre::Mesh* mesh, const Ogre::String& filename);
+
+    /** creates the submeshes of mesh from a blob in memory
+
+        @param verify check the size and hash of the blob before using it
+    */
+    static void importMesh(const void* data, size_t size, Ogre::Mesh* mesh, bool verify = true);
+
+    /// maps filename and imports it
+    static void importMesh(const Ogre::String& filename, Ogre::Mesh* mesh, bool verify = true);
+
+    /// reads the whole stream and imports it
+    static void importMesh(const Ogre::DataStreamPtr& stream, Ogre::Mesh* mesh, bool verify = true);
+
+    /// 64 bit FNV-1a, pass the hash of the preceding data as seed to hash in pieces
+    static Ogre::uint64 hash(const void* data, size_t size, Ogre::uint64 seed = 0xcbf29ce484222325ULL);
+};
+
+#endif // __MeshBlobSerializer_h__
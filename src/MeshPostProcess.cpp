@@ -0,0 +1,337 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include "MeshPostProcess.h"
+#include "MeshBlobSerializer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <assimp/mesh.h>
+
+namespace
+{
+// Assimp's default AI_CONFIG_PP_CT_MAX_SMOOTHING_ANGLE
+const float TANGENT_SMOOTHING_COS = 0.70710678f;
+
+aiVector3D normalised(const aiVector3D& v)
+{
+    float length = std::sqrt(v * v);
+    return length > 0 ? v / length : aiVector3D();
+}
+
+std::array<Ogre::uint32, 3> positionKey(const aiVector3D& v)
+{
+    // adding zero turns -0 into 0
+    float p[3] = {v.x + 0.0f, v.y + 0.0f, v.z + 0.0f};
+    std::array<Ogre::uint32, 3> key;
+    memcpy(key.data(), p, sizeof(p));
+    return key;
+}
+
+/** sorts the vertices by position
+
+    order lists the vertex indices so that vertices at the same position are adjacent,
+    range[v] is the run of order holding the vertices at the position of v.
+*/
+void groupByPosition(const aiMesh* mesh, std::vector<unsigned int>& order, std::vector<std::pair<unsigned int, unsigned int> >& range)
+{
+    std::vector<std::array<Ogre::uint32, 3> > keys(mesh->mNumVertices);
+    order.resize(mesh->mNumVertices);
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+    {
+        keys[v] = positionKey(mesh->mVertices[v]);
+        order[v] = v;
+    }
+    std::sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+
+    range.resize(mesh->mNumVertices);
+    for (unsigned int begin = 0, end; begin < order.size(); begin = end)
+    {
+        for (end = begin + 1; end < order.size() && keys[order[end]] == keys[order[begin]]; ++end)
+            ;
+        for (unsigned int i = begin; i < end; ++i)
+            range[order[i]] = std::make_pair(begin, end);
+    }
+}
+
+/// replaces the per vertex array by the vertices listed in kept
+template <typename T> void compact(T*& data, const std::vector<unsigned int>& kept)
+{
+    if (!data)
+        return;
+    T* compacted = new T[kept.size()];
+    for (size_t i = 0; i < kept.size(); ++i)
+        compacted[i] = data[kept[i]];
+    delete[] data;
+    data = compacted;
+}
+}
+
+void MeshPostProcess::generateSmoothNormals(aiMesh* mesh, float maxAngle)
+{
+    if (mesh->mNormals || !mesh->mNumVertices)
+        return;
+
+    // sum of the normals of the faces using each vertex, lines and points contribute none
+    std::vector<aiVector3D> faceNormals(mesh->mNumVertices);
+    for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+    {
+        const aiFace& face = mesh->mFaces[f];
+        if (face.mNumIndices != 3)
+            continue;
+        const aiVector3D& p0 = mesh->mVertices[face.mIndices[0]];
+        aiVector3D normal = normalised((mesh->mVertices[face.mIndices[1]] - p0) ^ (mesh->mVertices[face.mIndices[2]] - p0));
+        for (unsigned int i = 0; i < 3; ++i)
+            faceNormals[face.mIndices[i]] += normal;
+    }
+
+    std::vector<aiVector3D> directions(mesh->mNumVertices);
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+        directions[v] = normalised(faceNormals[v]);
+
+    std::vector<unsigned int> order;
+    std::vector<std::pair<unsigned int, unsigned int> > range;
+    groupByPosition(mesh, order, range);
+
+    // like Assimp, no limit above 175 degrees
+    const float minCos = maxAngle < 175.0f ? std::cos(maxAngle * 0.017453293f) : -2.0f;
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+    {
+        aiVector3D sum;
+        for (unsigned int i = range[v].first; i < range[v].second; ++i)
+        {
+            unsigned int w = order[i];
+            if (directions[v] * directions[w] >= minCos)
+                sum += faceNormals[w];
+        }
+        mesh->mNormals[v] = normalised(sum);
+    }
+}
+
+void MeshPostProcess::calcTangentSpace(aiMesh* mesh)
+{
+    if (!mesh->mNormals || !mesh->mTextureCoords[0] || mesh->mTangents || !mesh->mNumVertices)
+        return;
+
+    std::vector<aiVector3D> faceTangents(mesh->mNumVertices);
+    std::vector<aiVector3D> faceBitangents(mesh->mNumVertices);
+    for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+    {
+        const aiFace& face = mesh->mFaces[f];
+        if (face.mNumIndices != 3)
+            continue;
+        const unsigned int* idx = face.mIndices;
+        aiVector3D e1 = mesh->mVertices[idx[1]] - mesh->mVertices[idx[0]];
+        aiVector3D e2 = mesh->mVertices[idx[2]] - mesh->mVertices[idx[0]];
+        aiVector3D t1 = mesh->mTextureCoords[0][idx[1]] - mesh->mTextureCoords[0][idx[0]];
+        aiVector3D t2 = mesh->mTextureCoords[0][idx[2]] - mesh->mTextureCoords[0][idx[0]];
+
+        // only the direction matters, so the determinant contributes its sign
+        float direction = (t1.x * t2.y - t2.x * t1.y) < 0 ? -1.0f : 1.0f;
+        aiVector3D tangent = normalised((e1 * t2.y - e2 * t1.y) * direction);
+        aiVector3D bitangent = normalised((e2 * t1.x - e1 * t2.x) * direction);
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            faceTangents[idx[i]] += tangent;
+            faceBitangents[idx[i]] += bitangent;
+        }
+    }
+
+    std::vector<aiVector3D> directions(mesh->mNumVertices);
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+        directions[v] = normalised(faceTangents[v]);
+
+    std::vector<unsigned int> order;
+    std::vector<std::pair<unsigned int, unsigned int> > range;
+    groupByPosition(mesh, order, range);
+
+    mesh->mTangents = new aiVector3D[mesh->mNumVertices];
+    mesh->mBitangents = new aiVector3D[mesh->mNumVertices];
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+    {
+        const aiVector3D& normal = mesh->mNormals[v];
+        aiVector3D tangent, bitangent;
+        for (unsigned int i = range[v].first; i < range[v].second; ++i)
+        {
+            unsigned int w = order[i];
+            if (normal * mesh->mNormals[w] >= TANGENT_SMOOTHING_COS && directions[v] * directions[w] >= TANGENT_SMOOTHING_COS)
+            {
+                tangent += faceTangents[w];
+                bitangent += faceBitangents[w];
+            }
+        }
+
+        tangent = normalised(tangent - normal * (normal * tangent));
+        bitangent = normalised(bitangent - normal * (normal * bitangent));
+        if (tangent * tangent == 0)
+        {
+            // no usable UVs, any frame around the normal will do
+            tangent = normalised(normal ^ (std::abs(normal.x) < 0.9f ? aiVector3D(1, 0, 0) : aiVector3D(0, 1, 0)));
+            bitangent = normal ^ tangent;
+        }
+        mesh->mTangents[v] = tangent;
+        mesh->mBitangents[v] = bitangent;
+    }
+}
+
+unsigned int MeshPostProcess::joinIdenticalVertices(aiMesh* mesh)
+{
+    if (mesh->mNumAnimMeshes || !mesh->mNumVertices)
+        return 0;
+
+    // every attribute of a vertex, back to back
+    std::vector<const Ogre::uint8*> streams;
+    std::vector<size_t> strides;
+    auto addStream = [&](const void* data, size_t stride) {
+        if (!data)
+            return;
+        streams.push_back(static_cast<const Ogre::uint8*>(data));
+        strides.push_back(stride);
+    };
+    addStream(mesh->mVertices, sizeof(aiVector3D));
+    addStream(mesh->mNormals, sizeof(aiVector3D));
+    addStream(mesh->mTangents, sizeof(aiVector3D));
+    addStream(mesh->mBitangents, sizeof(aiVector3D));
+    for (unsigned int c = 0; c < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++c)
+        addStream(mesh->mTextureCoords[c], sizeof(aiVector3D));
+    for (unsigned int c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; ++c)
+        addStream(mesh->mColors[c], sizeof(aiColor4D));
+
+    size_t recordSize = 0;
+    for (size_t stride : strides)
+        recordSize += stride;
+    std::vector<Ogre::uint8> records(recordSize * mesh->mNumVertices);
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+    {
+        Ogre::uint8* record = &records[v * recordSize];
+        for (size_t s = 0; s < streams.size(); ++s)
+        {
+            memcpy(record, streams[s] + v * strides[s], strides[s]);
+            record += strides[s];
+        }
+    }
+
+    // bone index and weight of every influence, in bone order
+    std::vector<std::vector<std::pair<unsigned int, float> > > weights(mesh->mNumBones ? mesh->mNumVertices : 0);
+    for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+    {
+        const aiBone* bone = mesh->mBones[b];
+        for (unsigned int w = 0; w < bone->mNumWeights; ++w)
+        {
+            if (bone->mWeights[w].mVertexId < mesh->mNumVertices)
+                weights[bone->mWeights[w].mVertexId].push_back(std::make_pair(b, bone->mWeights[w].mWeight));
+        }
+    }
+
+    std::unordered_multimap<Ogre::uint64, unsigned int> joined;
+    joined.reserve(mesh->mNumVertices);
+    std::vector<unsigned int> remap(mesh->mNumVertices);
+    std::vector<unsigned int> kept;
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+    {
+        const Ogre::uint8* record = &records[v * recordSize];
+        Ogre::uint64 hash = MeshBlobSerializer::hash(record, recordSize);
+        if (!weights.empty() && !weights[v].empty())
+            hash ^= MeshBlobSerializer::hash(weights[v].data(), weights[v].size() * sizeof(weights[v][0])) * 31;
+
+        bool found = false;
+        auto candidates = joined.equal_range(hash);
+        for (auto it = candidates.first; it != candidates.second && !found; ++it)
+        {
+            unsigned int w = kept[it->second];
+            if (memcmp(record, &records[w * recordSize], recordSize) == 0 && (weights.empty() || weights[v] == weights[w]))
+            {
+                remap[v] = it->second;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            remap[v] = unsigned(kept.size());
+            joined.insert(std::make_pair(hash, remap[v]));
+            kept.push_back(v);
+        }
+    }
+
+    const unsigned int removed = mesh->mNumVertices - unsigned(kept.size());
+    if (!removed)
+        return 0;
+
+    compact(mesh->mVertices, kept);
+    compact(mesh->mNormals, kept);
+    compact(mesh->mTangents, kept);
+    compact(mesh->mBitangents, kept);
+    for (unsigned int c = 0; c < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++c)
+        compact(mesh->mTextureCoords[c], kept);
+    for (unsigned int c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; ++c)
+        compact(mesh->mColors[c], kept);
+    mesh->mNumVertices = unsigned(kept.size());
+
+    for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+    {
+        aiFace& face = mesh->mFaces[f];
+        for (unsigned int i = 0; i < face.mNumIndices; ++i)
+            face.mIndices[i] = remap[face.mIndices[i]];
+    }
+
+    // the weights of a joined vertex equal those of the one kept
+    for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+    {
+        aiBone* bone = mesh->mBones[b];
+        std::vector<aiVertexWeight> boneWeights;
+        for (unsigned int w = 0; w < bone->mNumWeights; ++w)
+        {
+            unsigned int v = bone->mWeights[w].mVertexId;
+            if (v < remap.size() && kept[remap[v]] == v)
+            {
+                aiVertexWeight weight = bone->mWeights[w];
+                weight.mVertexId = remap[v];
+                boneWeights.push_back(weight);
+            }
+        }
+        delete[] bone->mWeights;
+        bone->mWeights = boneWeights.empty() ? nullptr : new aiVertexWeight[boneWeights.size()];
+        std::copy(boneWeights.begin(), boneWeights.end(), bone->mWeights);
+        bone->mNumWeights = unsigned(boneWeights.size());
+    }
+
+    return removed;
+}
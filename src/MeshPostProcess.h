@@ -0,0 +1,74 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#ifndef __MeshPostProcess_h__
+#define __MeshPostProcess_h__
+
+struct aiMesh;
+
+/** Geometry post processing on imported meshes, in place of Assimp's serial steps
+
+    Counterparts of aiProcess_GenSmoothNormals, aiProcess_CalcTangentSpace and
+    aiProcess_JoinIdenticalVertices that work on one aiMesh at a time and touch nothing else,
+    so the meshes of a scene can be processed in parallel. Run them in the order Assimp does:
+    normals, tangents, then joining.
+*/
+class MeshPostProcess
+{
+public:
+    /** generates normals for a mesh without any
+
+        Every vertex averages the normals of the faces at its position that are at most maxAngle
+        degrees from its own faces, like PP_GSN_MAX_SMOOTHING_ANGLE.
+    */
+    static void generateSmoothNormals(aiMesh* mesh, float maxAngle);
+
+    /** generates tangents and bitangents from the first UV channel for a mesh with normals
+
+        Tangents of faces sharing a position are averaged within 45 degrees, the limit Assimp
+        uses by default. Like in Assimp, aiProcess_FlipUVs has to run before.
+    */
+    static void calcTangentSpace(aiMesh* mesh);
+
+    /** merges vertices with identical attributes and bone weights
+
+        Remaps the faces and bone weights. Meshes with morph targets are left alone.
+        Vertices are compared bitwise instead of with Assimp's epsilon.
+        @return number of vertices removed
+    */
+    static unsigned int joinIdenticalVertices(aiMesh* mesh);
+};
+
+#endif // __MeshPostProcess_h__
@@ -0,0 +1,187 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include "SceneCache.h"
+#include "MeshBlobSerializer.h"
+
+#include <vector>
+
+#include <assimp/scene.h>
+
+namespace
+{
+size_t estimateNodeSize(const aiNode* node)
+{
+    size_t bytes = sizeof(aiNode) + node->mNumMeshes * sizeof(unsigned int) + node->mNumChildren * sizeof(aiNode*);
+    for (unsigned int i = 0; i < node->mNumChildren; ++i)
+        bytes += estimateNodeSize(node->mChildren[i]);
+    return bytes;
+}
+}
+
+SceneCache& SceneCache::getSingleton()
+{
+    static SceneCache cache;
+    return cache;
+}
+
+SceneCache::SceneCache() : mBudget(0) {}
+
+void SceneCache::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBudget = bytes;
+    evict(bytes);
+}
+
+size_t SceneCache::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBudget;
+}
+
+Ogre::uint64 SceneCache::makeKey(Ogre::uint64 sourceHash, const void* settings, size_t size)
+{
+    Ogre::uint64 hashes[2] = {sourceHash, MeshBlobSerializer::hash(settings, size)};
+    return MeshBlobSerializer::hash(hashes, sizeof(hashes));
+}
+
+std::shared_ptr<const aiScene> SceneCache::find(Ogre::uint64 key, Ogre::StringVector* files)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntryByKey.find(key);
+    if (it == mEntryByKey.end())
+    {
+        mStats.misses++;
+        return std::shared_ptr<const aiScene>();
+    }
+
+    mStats.hits++;
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    if (files)
+        *files = it->second->files;
+    return it->second->scene;
+}
+
+std::shared_ptr<const aiScene> SceneCache::insert(Ogre::uint64 key, aiScene* scene, const Ogre::StringVector& files)
+{
+    std::shared_ptr<const aiScene> shared(scene);
+    const size_t bytes = estimateSize(scene);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    // a scene larger than the budget would only evict everything else
+    if (bytes > mBudget || mEntryByKey.count(key))
+        return shared;
+
+    Entry entry = {key, shared, files, bytes};
+    mEntries.push_front(entry);
+    mEntryByKey[key] = mEntries.begin();
+    mStats.entries++;
+    mStats.bytes += bytes;
+    evict(mBudget);
+    return shared;
+}
+
+void SceneCache::evict(size_t budget)
+{
+    while (mStats.bytes > budget && !mEntries.empty())
+    {
+        const Entry& oldest = mEntries.back();
+        mStats.bytes -= oldest.bytes;
+        mStats.entries--;
+        mStats.evictions++;
+        mEntryByKey.erase(oldest.key);
+        mEntries.pop_back();
+    }
+}
+
+void SceneCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+    mEntryByKey.clear();
+    mStats.entries = 0;
+    mStats.bytes = 0;
+}
+
+SceneCache::Stats SceneCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+size_t SceneCache::estimateSize(const aiScene* scene)
+{
+    size_t bytes = sizeof(aiScene);
+    for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+    {
+        const aiMesh* mesh = scene->mMeshes[m];
+        size_t vertexSize = sizeof(aiVector3D) * (1 + (mesh->mNormals != NULL) + (mesh->mTangents != NULL) +
+                                                  (mesh->mBitangents != NULL));
+        for (unsigned int c = 0; c < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++c)
+            vertexSize += mesh->mTextureCoords[c] ? sizeof(aiVector3D) : 0;
+        for (unsigned int c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; ++c)
+            vertexSize += mesh->mColors[c] ? sizeof(aiColor4D) : 0;
+
+        bytes += sizeof(aiMesh) + mesh->mNumVertices * vertexSize;
+        for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+            bytes += sizeof(aiFace) + mesh->mFaces[f].mNumIndices * sizeof(unsigned int);
+        for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+            bytes += sizeof(aiBone) + mesh->mBones[b]->mNumWeights * sizeof(aiVertexWeight);
+    }
+
+    for (unsigned int a = 0; a < scene->mNumAnimations; ++a)
+    {
+        const aiAnimation* anim = scene->mAnimations[a];
+        bytes += sizeof(aiAnimation);
+        for (unsigned int c = 0; c < anim->mNumChannels; ++c)
+        {
+            const aiNodeAnim* channel = anim->mChannels[c];
+            bytes += sizeof(aiNodeAnim) + (channel->mNumPositionKeys + channel->mNumScalingKeys) * sizeof(aiVectorKey) +
+                     channel->mNumRotationKeys * sizeof(aiQuatKey);
+        }
+    }
+
+    for (unsigned int m = 0; m < scene->mNumMaterials; ++m)
+    {
+        const aiMaterial* mat = scene->mMaterials[m];
+        for (unsigned int p = 0; p < mat->mNumProperties; ++p)
+            bytes += sizeof(aiMaterialProperty) + mat->mProperties[p]->mDataLength;
+    }
+
+    if (scene->mRootNode)
+        bytes += estimateNodeSize(scene->mRootNode);
+    return bytes;
+}
@@ -0,0 +1,124 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#ifndef __SceneCache_h__
+#define __SceneCache_h__
+
+#include <OgrePrerequisites.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+struct aiScene;
+
+/** Process wide LRU cache of post processed Assimp scenes
+
+    Importing the same source several times, e.g. with different LOD, collision or animation
+    options, then parses and post processes it once. Entries are keyed by makeKey and hold the
+    scene read only. The least recently used entries are dropped when the estimated size of all
+    entries exceeds the budget, scenes still in use live on until released. Disabled with a
+    budget of 0, the default. Thread safe.
+*/
+class SceneCache
+{
+public:
+    struct Stats
+    {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t entries;
+        size_t bytes; // estimated size of the cached scenes
+
+        Stats() : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+    };
+
+    static SceneCache& getSingleton();
+
+    /// estimated bytes the cached scenes may take, 0 disables and empties the cache
+    void setBudget(size_t bytes);
+    size_t getBudget() const;
+    bool isEnabled() const { return getBudget() > 0; }
+
+    /** key of a source imported with a set of Assimp settings
+        @param sourceHash hash of the main file, the contents of auxiliary files are not covered;
+        stream loads add the resource group and the names their auxiliary files resolve to
+        @param settings everything else that changes the imported scene, e.g. post process flags
+    */
+    static Ogre::uint64 makeKey(Ogre::uint64 sourceHash, const void* settings, size_t size);
+
+    /** the scene cached under key, null if there is none
+        @param files receives the files that were opened while importing the scene
+    */
+    std::shared_ptr<const aiScene> find(Ogre::uint64 key, Ogre::StringVector* files = NULL);
+
+    /** caches scene, which must have been taken from its importer with GetOrphanedScene
+        @param files the files that were opened while importing it, handed out again by find
+    */
+    std::shared_ptr<const aiScene> insert(Ogre::uint64 key, aiScene* scene, const Ogre::StringVector& files);
+
+    void clear();
+
+    Stats getStats() const;
+
+    /// rough size of the meshes, animations, nodes and materials of scene
+    static size_t estimateSize(const aiScene* scene);
+
+private:
+    SceneCache();
+    SceneCache(const SceneCache&);
+    SceneCache& operator=(const SceneCache&);
+
+    struct Entry
+    {
+        Ogre::uint64 key;
+        std::shared_ptr<const aiScene> scene;
+        Ogre::StringVector files;
+        size_t bytes;
+    };
+    typedef std::list<Entry> EntryList;
+
+    void evict(size_t budget);
+
+    mutable std::mutex mMutex;
+    size_t mBudget;
+    EntryList mEntries; // most recently used first
+    std::map<Ogre::uint64, EntryList::iterator> mEntryByKey;
+    Stats mStats;
+};
+
+#endif // __SceneCache_h__
@@ -0,0 +1,519 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#include <Ogre.h>
+
+namespace
+{
+// coordinates this far outside [0, 1] still count as not tiling
+const float UV_EPSILON = 1e-3f;
+
+/// returns why the material can not be atlased, or sets key to the pass state it must share
+Ogre::String checkMaterial(Ogre::Material* mat, Ogre::String& key)
+{
+    if (mat->getNumTechniques() != 1 || mat->getTechnique(0)->getNumPasses() != 1)
+        return "has more than one technique or pass";
+
+    const Ogre::Pass* pass = mat->getTechnique(0)->getPass(0);
+    if (pass->getNumTextureUnitStates() != 1)
+        return "has " + Ogre::StringConverter::toString(pass->getNumTextureUnitStates()) + " texture units";
+
+    const Ogre::TextureUnitState* tus = pass->getTextureUnitState(0);
+    if (tus->getTextureName().empty() || tus->getNumFrames() != 1)
+        return "has no single static texture";
+    if (tus->getTextureCoordSet() != 0)
+        return "samples texture coordinate set " + Ogre::StringConverter::toString(tus->getTextureCoordSet());
+    if (!tus->getEffects().empty() || tus->getTextureUScale() != 1 || tus->getTextureVScale() != 1 ||
+        tus->getTextureUScroll() != 0 || tus->getTextureVScroll() != 0)
+        return "transforms its texture coordinates";
+
+    const Ogre::TextureUnitState::UVWAddressingMode& mode = tus->getTextureAddressingMode();
+    Ogre::StringStream str;
+    str << Ogre::StringConverter::toString(pass->getAmbient()) << "|"
+        << Ogre::StringConverter::toString(pass->getDiffuse()) << "|"
+        << Ogre::StringConverter::toString(pass->getSpecular()) << "|"
+        << Ogre::StringConverter::toString(pass->getSelfIllumination()) << "|" << pass->getShininess() << "|"
+        << int(pass->getSourceBlendFactor()) << " " << int(pass->getDestBlendFactor()) << "|"
+        << pass->getDepthWriteEnabled() << " " << int(pass->getCullingMode()) << " " << pass->getLightingEnabled() << " "
+        << int(pass->getShadingMode()) << " " << int(pass->getAlphaRejectFunction()) << " "
+        << int(pass->getAlphaRejectValue()) << "|" << int(mode.u) << " " << int(mode.v) << " " << int(mode.w);
+    key = str.str();
+    return "";
+}
+
+size_t countMaterials(const std::vector<Ogre::Mesh*>& meshes, size_t& drawCalls)
+{
+    std::set<Ogre::String> names;
+    drawCalls = 0;
+    for (Ogre::Mesh* mesh : meshes)
+    {
+        for (Ogre::SubMesh* sm : mesh->getSubMeshes())
+            names.insert(sm->getMaterialName());
+        drawCalls += mesh->getNumSubMeshes();
+    }
+    return names.size();
+}
+}
+
+struct TextureAtlas::Candidate
+{
+    Ogre::MaterialPtr material;
+    Ogre::String key;
+    Ogre::String reason; // empty while eligible
+    std::vector<Ogre::SubMesh*> subMeshes;
+};
+
+struct TextureAtlas::Texture
+{
+    Ogre::String name;
+    Ogre::Image image;
+    std::vector<Candidate*> users;
+    Ogre::uint32 x, y; // top left corner of the padded slot
+};
+
+bool TextureAtlas::checkCoordinates(Ogre::SubMesh* sm, Ogre::String& reason)
+{
+    if (sm->useSharedVertices || sm->operationType != Ogre::RenderOperation::OT_TRIANGLE_LIST)
+    {
+        reason = "uses shared vertices or no triangle list";
+        return false;
+    }
+
+    Ogre::VertexData* vertexData = sm->vertexData;
+    const Ogre::VertexElement* elem =
+        vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_TEXTURE_COORDINATES, 0);
+    if (!elem || elem->getType() != Ogre::VET_FLOAT2)
+    {
+        reason = "has no 2D texture coordinates";
+        return false;
+    }
+
+    const Ogre::HardwareVertexBufferSharedPtr& buf = vertexData->vertexBufferBinding->getBuffer(elem->getSource());
+    std::vector<Ogre::uchar> data(buf->getSizeInBytes());
+    buf->readData(0, data.size(), data.data());
+
+    float lo[2] = {0, 0};
+    float hi[2] = {1, 1};
+    for (size_t v = vertexData->vertexStart; v < vertexData->vertexStart + vertexData->vertexCount; ++v)
+    {
+        float uv[2];
+        memcpy(uv, &data[v * buf->getVertexSize() + elem->getOffset()], sizeof(uv));
+        for (int i = 0; i < 2; ++i)
+        {
+            lo[i] = std::min(lo[i], uv[i]);
+            hi[i] = std::max(hi[i], uv[i]);
+        }
+    }
+
+    if (lo[0] < -UV_EPSILON || lo[1] < -UV_EPSILON || hi[0] > 1 + UV_EPSILON || hi[1] > 1 + UV_EPSILON)
+    {
+        reason = Ogre::StringUtil::format("UVs span [%g, %g] x [%g, %g], tiling beyond 0..1", lo[0], hi[0], lo[1], hi[1]);
+        return false;
+    }
+    return true;
+}
+
+void TextureAtlas::remapCoordinates(Ogre::VertexData* vertexData, const Ogre::Vector4& rect)
+{
+    const Ogre::VertexElement* elem =
+        vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_TEXTURE_COORDINATES, 0);
+    const Ogre::HardwareVertexBufferSharedPtr& buf = vertexData->vertexBufferBinding->getBuffer(elem->getSource());
+    std::vector<Ogre::uchar> data(buf->getSizeInBytes());
+    buf->readData(0, data.size(), data.data());
+
+    for (size_t v = vertexData->vertexStart; v < vertexData->vertexStart + vertexData->vertexCount; ++v)
+    {
+        Ogre::uchar* dst = &data[v * buf->getVertexSize() + elem->getOffset()];
+        float uv[2];
+        memcpy(uv, dst, sizeof(uv));
+        uv[0] = rect.x + Ogre::Math::Clamp(uv[0], 0.0f, 1.0f) * rect.z;
+        uv[1] = rect.y + Ogre::Math::Clamp(uv[1], 0.0f, 1.0f) * rect.w;
+        memcpy(dst, uv, sizeof(uv));
+    }
+
+    buf->writeData(0, data.size(), data.data(), true);
+}
+
+void TextureAtlas::blit(const Ogre::Image& src, Ogre::Image& atlas, Ogre::uint32 x, Ogre::uint32 y) const
+{
+    const Ogre::uint32 w = src.getWidth();
+    const Ogre::uint32 h = src.getHeight();
+    const Ogre::PixelBox dst = atlas.getPixelBox();
+    Ogre::PixelUtil::bulkPixelConversion(src.getPixelBox(), dst.getSubVolume(Ogre::Box(x, y, x + w, y + h)));
+
+    // repeat the outermost rows, then the outermost columns including the new rows
+    for (Ogre::uint32 p = 1; p <= padding; ++p)
+    {
+        Ogre::PixelUtil::bulkPixelConversion(dst.getSubVolume(Ogre::Box(x, y, x + w, y + 1)),
+                                             dst.getSubVolume(Ogre::Box(x, y - p, x + w, y - p + 1)));
+        Ogre::PixelUtil::bulkPixelConversion(dst.getSubVolume(Ogre::Box(x, y + h - 1, x + w, y + h)),
+                                             dst.getSubVolume(Ogre::Box(x, y + h - 1 + p, x + w, y + h + p)));
+    }
+    for (Ogre::uint32 p = 1; p <= padding; ++p)
+    {
+        Ogre::PixelUtil::bulkPixelConversion(dst.getSubVolume(Ogre::Box(x, y - padding, x + 1, y + h + padding)),
+                                             dst.getSubVolume(Ogre::Box(x - p, y - padding, x - p + 1, y + h + padding)));
+        Ogre::PixelUtil::bulkPixelConversion(dst.getSubVolume(Ogre::Box(x + w - 1, y - padding, x + w, y + h + padding)),
+                                             dst.getSubVolume(Ogre::Box(x + w - 1 + p, y - padding, x + w + p, y + h + padding)));
+    }
+}
+
+bool TextureAtlas::canMerge(const Ogre::SubMesh* a, const Ogre::SubMesh* b)
+{
+    if (a->getMaterialName() != b->getMaterialName())
+        return false;
+
+    // skinned submeshes each have their own bone palette
+    for (const Ogre::SubMesh* sm : {a, b})
+    {
+        if (sm->useSharedVertices || sm->operationType != Ogre::RenderOperation::OT_TRIANGLE_LIST || !sm->indexData->indexBuffer ||
+            !sm->getBoneAssignments().empty() || !sm->blendIndexToBoneIndexMap.empty())
+            return false;
+    }
+
+    const Ogre::VertexDeclaration::VertexElementList& ea = a->vertexData->vertexDeclaration->getElements();
+    const Ogre::VertexDeclaration::VertexElementList& eb = b->vertexData->vertexDeclaration->getElements();
+    if (ea.size() != eb.size() || !std::equal(ea.begin(), ea.end(), eb.begin()))
+        return false;
+
+    const Ogre::VertexBufferBinding::VertexBufferBindingMap& ba = a->vertexData->vertexBufferBinding->getBindings();
+    const Ogre::VertexBufferBinding::VertexBufferBindingMap& bb = b->vertexData->vertexBufferBinding->getBindings();
+    if (ba.size() != bb.size())
+        return false;
+    for (const auto& binding : ba)
+    {
+        auto other = bb.find(binding.first);
+        if (other == bb.end() || other->second->getVertexSize() != binding.second->getVertexSize())
+            return false;
+    }
+    return true;
+}
+
+void TextureAtlas::mergeMeshSubMeshes(Ogre::Mesh* mesh)
+{
+    if (mesh->getNumLodLevels() > 1 || mesh->hasVertexAnimation())
+        return;
+
+    // groups of submesh indices, the first one receives the others
+    std::vector<std::vector<unsigned short> > groups;
+    for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+    {
+        Ogre::SubMesh* sm = mesh->getSubMesh(i);
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<unsigned short>& g) {
+            return canMerge(mesh->getSubMesh(g[0]), sm);
+        });
+        if (group != groups.end())
+            group->push_back(i);
+        else
+            groups.push_back(std::vector<unsigned short>(1, i));
+    }
+
+    std::vector<unsigned short> merged;
+    for (const std::vector<unsigned short>& group : groups)
+    {
+        if (group.size() < 2)
+            continue;
+
+        Ogre::SubMesh* head = mesh->getSubMesh(group[0]);
+        size_t vertexCount = 0;
+        for (unsigned short i : group)
+            vertexCount += mesh->getSubMesh(i)->vertexData->vertexCount;
+
+        Ogre::VertexData* vertexData = head->vertexData->clone(false);
+        vertexData->vertexStart = 0;
+        vertexData->vertexCount = vertexCount;
+        for (const auto& binding : head->vertexData->vertexBufferBinding->getBindings())
+        {
+            const size_t vertexSize = binding.second->getVertexSize();
+            Ogre::HardwareVertexBufferSharedPtr buf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+                vertexSize, vertexCount, binding.second->getUsage(), binding.second->hasShadowBuffer());
+
+            size_t offset = 0;
+            for (unsigned short i : group)
+            {
+                const Ogre::VertexData* part = mesh->getSubMesh(i)->vertexData;
+                std::vector<Ogre::uchar> bytes(part->vertexCount * vertexSize);
+                part->vertexBufferBinding->getBuffer(binding.first)->readData(part->vertexStart * vertexSize, bytes.size(), bytes.data());
+                buf->writeData(offset, bytes.size(), bytes.data(), offset == 0);
+                offset += bytes.size();
+            }
+            vertexData->vertexBufferBinding->setBinding(binding.first, buf);
+        }
+
+        // indices are relative to vertexStart, so each part is offset by the vertices before it
+        std::vector<Ogre::uint32> indices;
+        Ogre::uint32 base = 0;
+        for (unsigned short i : group)
+        {
+            const Ogre::SubMesh* part = mesh->getSubMesh(i);
+            const Ogre::HardwareIndexBufferSharedPtr& ibuf = part->indexData->indexBuffer;
+            const size_t indexSize = ibuf->getIndexSize();
+            std::vector<Ogre::uchar> bytes(part->indexData->indexCount * indexSize);
+            ibuf->readData(part->indexData->indexStart * indexSize, bytes.size(), bytes.data());
+            for (size_t j = 0; j < part->indexData->indexCount; ++j)
+            {
+                Ogre::uint32 index;
+                if (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT)
+                    memcpy(&index, &bytes[j * 4], 4);
+                else
+                {
+                    Ogre::uint16 index16;
+                    memcpy(&index16, &bytes[j * 2], 2);
+                    index = index16;
+                }
+                indices.push_back(base + index);
+            }
+            base += Ogre::uint32(part->vertexData->vertexCount);
+        }
+
+        const bool use32 = vertexCount > 0xFFFF;
+        Ogre::HardwareIndexBufferSharedPtr ibuf = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+            use32 ? Ogre::HardwareIndexBuffer::IT_32BIT : Ogre::HardwareIndexBuffer::IT_16BIT, indices.size(),
+            head->indexData->indexBuffer->getUsage(), head->indexData->indexBuffer->hasShadowBuffer());
+        if (use32)
+        {
+            ibuf->writeData(0, indices.size() * 4, indices.data(), true);
+        }
+        else
+        {
+            std::vector<Ogre::uint16> indices16(indices.begin(), indices.end());
+            ibuf->writeData(0, indices16.size() * 2, indices16.data(), true);
+        }
+
+        delete head->vertexData;
+        head->vertexData = vertexData;
+        head->indexData->indexBuffer = ibuf;
+        head->indexData->indexStart = 0;
+        head->indexData->indexCount = indices.size();
+
+        merged.insert(merged.end(), group.begin() + 1, group.end());
+    }
+
+    // destroying from the back keeps the remaining indices valid
+    std::sort(merged.rbegin(), merged.rend());
+    for (unsigned short i : merged)
+        mesh->destroySubMesh(i);
+}
+
+void TextureAtlas::build(const std::vector<Ogre::Mesh*>& meshes, const Ogre::String& name, const Ogre::String& group)
+{
+    mReport = Report();
+    mImageNames.clear();
+    mImages.clear();
+    mReport.materialsBefore = countMaterials(meshes, mReport.drawCallsBefore);
+
+    // the atlas dimensions are rounded up to powers of two, so the limit has to be one already
+    const Ogre::uint32 limit = maxSize ? 1u << Ogre::Bitwise::mostSignificantBitSet(maxSize) : 0;
+
+    // material name -> candidate, ordered so the atlases do not depend on the submesh order
+    std::map<Ogre::String, Candidate> candidates;
+    for (Ogre::Mesh* mesh : meshes)
+    {
+        for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+        {
+            Ogre::SubMesh* sm = mesh->getSubMesh(i);
+            Ogre::MaterialPtr mat = Ogre::MaterialManager::getSingleton().getByName(sm->getMaterialName());
+            if (!mat)
+                continue;
+
+            Candidate& candidate = candidates[mat->getName()];
+            if (!candidate.material)
+            {
+                candidate.material = mat;
+                candidate.reason = checkMaterial(mat.get(), candidate.key);
+            }
+            candidate.subMeshes.push_back(sm);
+
+            Ogre::String reason;
+            if (candidate.reason.empty() && !checkCoordinates(sm, reason))
+                candidate.reason = "submesh " + Ogre::StringConverter::toString(i) + " of " + mesh->getName() + " " + reason;
+        }
+    }
+
+    // pass state -> texture name -> texture
+    std::map<Ogre::String, std::map<Ogre::String, Texture> > groups;
+    for (auto& entry : candidates)
+    {
+        Candidate& candidate = entry.second;
+        if (!candidate.reason.empty())
+            continue;
+
+        const Ogre::String& texName = candidate.material->getTechnique(0)->getPass(0)->getTextureUnitState(0)->getTextureName();
+        Texture& tex = groups[candidate.key][texName];
+        if (tex.name.empty())
+        {
+            tex.name = texName;
+            Ogre::String base, ext;
+            Ogre::StringUtil::splitBaseFilename(texName, base, ext);
+            Ogre::StringUtil::toLowerCase(ext);
+            if (!ext.empty() && !Ogre::Codec::isCodecRegistered(ext))
+            {
+                candidate.reason = "texture " + texName + " could not be loaded: no image codec for ." + ext + " is registered";
+                continue;
+            }
+            try
+            {
+                tex.image.load(texName, group);
+            }
+            catch (Ogre::Exception& e)
+            {
+                candidate.reason = "texture " + texName + " could not be loaded: " + e.getDescription();
+            }
+        }
+        if (!tex.image.getWidth())
+        {
+            if (candidate.reason.empty())
+                candidate.reason = "texture " + texName + " could not be loaded";
+            continue;
+        }
+        if (tex.image.getWidth() + 2 * padding > limit || tex.image.getHeight() + 2 * padding > limit)
+        {
+            candidate.reason = Ogre::StringUtil::format("texture %s is %ux%u, too large for a %u atlas", texName.c_str(),
+                                                        tex.image.getWidth(), tex.image.getHeight(), limit);
+            continue;
+        }
+        tex.users.push_back(&candidate);
+    }
+
+    for (auto& entry : groups)
+    {
+        std::vector<Texture*> textures;
+        for (auto& tex : entry.second)
+        {
+            if (!tex.second.users.empty())
+                textures.push_back(&tex.second);
+        }
+        std::stable_sort(textures.begin(), textures.end(), [](const Texture* a, const Texture* b) {
+            return a->image.getHeight() > b->image.getHeight();
+        });
+
+        // shelf packing, the tallest texture of a shelf comes first
+        std::vector<std::vector<Texture*> > atlases;
+        std::vector<Ogre::uint32> atlasWidth, atlasHeight;
+        Ogre::uint32 shelfX = 0, shelfY = 0, shelfHeight = 0;
+        for (Texture* tex : textures)
+        {
+            const Ogre::uint32 w = tex->image.getWidth() + 2 * padding;
+            const Ogre::uint32 h = tex->image.getHeight() + 2 * padding;
+            if (!atlases.empty() && shelfX + w > limit)
+            {
+                shelfY += shelfHeight;
+                shelfX = shelfHeight = 0;
+            }
+            if (atlases.empty() || shelfY + h > limit)
+            {
+                atlases.push_back(std::vector<Texture*>());
+                atlasWidth.push_back(0);
+                atlasHeight.push_back(0);
+                shelfX = shelfY = shelfHeight = 0;
+            }
+
+            tex->x = shelfX;
+            tex->y = shelfY;
+            atlases.back().push_back(tex);
+            shelfX += w;
+            shelfHeight = std::max(shelfHeight, h);
+            atlasWidth.back() = std::max(atlasWidth.back(), shelfX);
+            atlasHeight.back() = std::max(atlasHeight.back(), shelfY + h);
+        }
+
+        for (size_t a = 0; a < atlases.size(); ++a)
+        {
+            size_t users = 0;
+            for (Texture* tex : atlases[a])
+                users += tex->users.size();
+            // a lone material gains nothing from an atlas
+            if (users < 2)
+                continue;
+
+            const Ogre::uint32 width = Ogre::Bitwise::firstPO2From(atlasWidth[a]);
+            const Ogre::uint32 height = Ogre::Bitwise::firstPO2From(atlasHeight[a]);
+            const size_t bytes = Ogre::PixelUtil::getMemorySize(width, height, 1, Ogre::PF_BYTE_RGBA);
+            Ogre::uchar* data = OGRE_ALLOC_T(Ogre::uchar, bytes, Ogre::MEMCATEGORY_GENERAL);
+            memset(data, 0, bytes);
+
+            const Ogre::String atlasName = name + "_atlas" + Ogre::StringConverter::toString(mImages.size());
+            mImageNames.push_back(atlasName + ".png");
+            mImages.push_back(Ogre::Image());
+            Ogre::Image& image = mImages.back();
+            image.loadDynamicImage(data, width, height, 1, Ogre::PF_BYTE_RGBA, true);
+
+            Ogre::MaterialPtr atlasMat = Ogre::static_pointer_cast<Ogre::Material>(
+                Ogre::MaterialManager::getSingleton().createOrRetrieve(atlasName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME).first);
+            atlases[a][0]->users[0]->material->copyDetailsTo(atlasMat);
+            atlasMat->getTechnique(0)->getPass(0)->getTextureUnitState(0)->setTextureName(mImageNames.back());
+
+            std::set<Ogre::VertexData*> remapped;
+            for (Texture* tex : atlases[a])
+            {
+                blit(tex->image, image, tex->x + padding, tex->y + padding);
+
+                Ogre::Vector4 rect(Ogre::Real(tex->x + padding) / width, Ogre::Real(tex->y + padding) / height,
+                                   Ogre::Real(tex->image.getWidth()) / width, Ogre::Real(tex->image.getHeight()) / height);
+                for (Candidate* candidate : tex->users)
+                {
+                    for (Ogre::SubMesh* sm : candidate->subMeshes)
+                    {
+                        if (remapped.insert(sm->vertexData).second)
+                            remapCoordinates(sm->vertexData, rect);
+                        sm->setMaterialName(atlasName);
+                    }
+                }
+                // the source is not needed anymore
+                tex->image = Ogre::Image();
+            }
+        }
+    }
+
+    for (auto& entry : candidates)
+    {
+        if (!entry.second.reason.empty())
+            mReport.ineligible.push_back(entry.first + ": " + entry.second.reason);
+    }
+
+    if (mergeSubMeshes)
+    {
+        for (Ogre::Mesh* mesh : meshes)
+            mergeMeshSubMeshes(mesh);
+    }
+
+    mReport.materialsAfter = countMaterials(meshes, mReport.drawCallsAfter);
+}
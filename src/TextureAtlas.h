@@ -0,0 +1,104 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#ifndef __TextureAtlas_h__
+#define __TextureAtlas_h__
+
+#include <OgrePrerequisites.h>
+#include <OgreImage.h>
+
+/** Packs the diffuse textures of compatible materials into atlases
+
+    A material is a candidate if it has a single pass with a single texture unit sampling
+    texture coordinate set 0 without transforms, and every submesh using it keeps its coordinates
+    within [0, 1]. Candidates with the same pass state apart from the texture (colours, blending,
+    culling, addressing) are packed together. Their coordinates are remapped into the atlas and
+    they are replaced by one material per atlas. Afterwards the static submeshes of a mesh sharing
+    a material and a vertex layout are merged, so each atlas costs one draw call per mesh.
+
+    Works on meshes in system memory, as created by the converter.
+*/
+class TextureAtlas
+{
+public:
+    struct Report
+    {
+        size_t materialsBefore;
+        size_t materialsAfter;
+        size_t drawCallsBefore; // submeshes before
+        size_t drawCallsAfter;  // submeshes after
+        Ogre::StringVector ineligible; // "<material>: <reason>" for every candidate left alone
+
+        Report() : materialsBefore(0), materialsAfter(0), drawCallsBefore(0), drawCallsAfter(0) {}
+    };
+
+    TextureAtlas() : maxSize(2048), padding(4), mergeSubMeshes(true) {}
+
+    /// largest atlas width and height in pixels, rounded down to a power of two
+    Ogre::uint32 maxSize;
+    /// edge pixels repeated around every texture, so filtering and mipmaps do not bleed
+    Ogre::uint32 padding;
+    /// merge submeshes sharing a material afterwards, this changes the submesh indices
+    bool mergeSubMeshes;
+
+    /** atlases the materials of meshes
+
+        The atlas images and materials are named <name>_atlas<n>. Textures are loaded from group.
+    */
+    void build(const std::vector<Ogre::Mesh*>& meshes, const Ogre::String& name, const Ogre::String& group);
+
+    const Report& getReport() const { return mReport; }
+
+    /// names of the atlas images, as referenced by the atlas materials
+    const Ogre::StringVector& getImageNames() const { return mImageNames; }
+    /// the atlas images, indexed like getImageNames
+    std::vector<Ogre::Image>& getImages() { return mImages; }
+
+private:
+    struct Candidate;
+    struct Texture;
+
+    static bool checkCoordinates(Ogre::SubMesh* sm, Ogre::String& reason);
+    static void remapCoordinates(Ogre::VertexData* vertexData, const Ogre::Vector4& rect);
+    static bool canMerge(const Ogre::SubMesh* a, const Ogre::SubMesh* b);
+    static void mergeMeshSubMeshes(Ogre::Mesh* mesh);
+    void blit(const Ogre::Image& src, Ogre::Image& atlas, Ogre::uint32 x, Ogre::uint32 y) const;
+
+    Report mReport;
+    Ogre::StringVector mImageNames;
+    std::vector<Ogre::Image> mImages;
+};
+
+#endif // __TextureAtlas_h__
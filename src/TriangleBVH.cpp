@@ -0,0 +1,409 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include "TriangleBVH.h"
+
+#include <fstream>
+
+#include <Ogre.h>
+
+namespace
+{
+const Ogre::uint32 BVH_MAGIC = 0x4856424F; // "OBVH"
+const Ogre::uint32 BVH_VERSION = 1;
+
+const Ogre::uint32 MAX_LEAF_TRIANGLES = 4;
+const int SAH_BINS = 16;
+
+struct Bounds
+{
+    float min[3];
+    float max[3];
+
+    Bounds()
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            min[a] = std::numeric_limits<float>::max();
+            max[a] = -std::numeric_limits<float>::max();
+        }
+    }
+
+    void merge(const float* p)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            min[a] = std::min(min[a], p[a]);
+            max[a] = std::max(max[a], p[a]);
+        }
+    }
+
+    void merge(const Bounds& b)
+    {
+        merge(b.min);
+        merge(b.max);
+    }
+
+    float area() const
+    {
+        float d[3];
+        for (int a = 0; a < 3; ++a)
+            d[a] = std::max(0.0f, max[a] - min[a]);
+        return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+    }
+};
+
+float centroid(const TriangleBVH::Triangle& tri, int axis)
+{
+    return (tri.v[0][axis] + tri.v[1][axis] + tri.v[2][axis]) / 3.0f;
+}
+
+bool intersectBox(const TriangleBVH::Node& node, const float* origin, const float* invDir, float maxDistance)
+{
+    float tmin = 0, tmax = maxDistance;
+    for (int a = 0; a < 3; ++a)
+    {
+        float t0 = (node.min[a] - origin[a]) * invDir[a];
+        float t1 = (node.max[a] - origin[a]) * invDir[a];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if (tmin > tmax)
+            return false;
+    }
+    return true;
+}
+
+// Moeller-Trumbore, both sides
+bool intersectTriangle(const TriangleBVH::Triangle& tri, const float* origin, const float* dir, float& t)
+{
+    const float EPSILON = 1e-7f;
+    float e1[3], e2[3], p[3], s[3], q[3];
+    for (int a = 0; a < 3; ++a)
+    {
+        e1[a] = tri.v[1][a] - tri.v[0][a];
+        e2[a] = tri.v[2][a] - tri.v[0][a];
+        s[a] = origin[a] - tri.v[0][a];
+    }
+    p[0] = dir[1] * e2[2] - dir[2] * e2[1];
+    p[1] = dir[2] * e2[0] - dir[0] * e2[2];
+    p[2] = dir[0] * e2[1] - dir[1] * e2[0];
+
+    float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (std::abs(det) < EPSILON)
+        return false;
+    float invDet = 1.0f / det;
+
+    float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+    if (u < 0 || u > 1)
+        return false;
+
+    q[0] = s[1] * e1[2] - s[2] * e1[1];
+    q[1] = s[2] * e1[0] - s[0] * e1[2];
+    q[2] = s[0] * e1[1] - s[1] * e1[0];
+
+    float v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * invDet;
+    if (v < 0 || u + v > 1)
+        return false;
+
+    t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+    return t >= 0;
+}
+}
+
+void TriangleBVH::clear()
+{
+    mNodes.clear();
+    mTriangles.clear();
+    subMeshBounds.clear();
+}
+
+void TriangleBVH::build(std::vector<Triangle>& triangles)
+{
+    mNodes.clear();
+    mTriangles.swap(triangles);
+    triangles.clear();
+
+    if (mTriangles.empty())
+        return;
+
+    mNodes.reserve(mTriangles.size() * 2 / MAX_LEAF_TRIANGLES + 1);
+    mNodes.push_back(Node());
+    buildNode(0, 0, mTriangles.size());
+}
+
+void TriangleBVH::buildNode(Ogre::uint32 nodeIndex, Ogre::uint32 first, Ogre::uint32 count)
+{
+    Bounds bounds, centroids;
+    for (Ogre::uint32 i = first; i < first + count; ++i)
+    {
+        const Triangle& tri = mTriangles[i];
+        float c[3] = {centroid(tri, 0), centroid(tri, 1), centroid(tri, 2)};
+        bounds.merge(tri.v[0]);
+        bounds.merge(tri.v[1]);
+        bounds.merge(tri.v[2]);
+        centroids.merge(c);
+    }
+
+    std::copy(bounds.min, bounds.min + 3, mNodes[nodeIndex].min);
+    std::copy(bounds.max, bounds.max + 3, mNodes[nodeIndex].max);
+    mNodes[nodeIndex].first = first;
+    mNodes[nodeIndex].count = count;
+
+    if (count <= MAX_LEAF_TRIANGLES)
+        return;
+
+    // binned SAH: find the cheapest split plane over all three axes
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = bounds.area() * count;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float extent = centroids.max[axis] - centroids.min[axis];
+        if (extent <= 0)
+            continue;
+        float scale = SAH_BINS / extent;
+
+        Bounds binBounds[SAH_BINS];
+        Ogre::uint32 binCount[SAH_BINS] = {0};
+        for (Ogre::uint32 i = first; i < first + count; ++i)
+        {
+            const Triangle& tri = mTriangles[i];
+            int bin = std::min(SAH_BINS - 1, int((centroid(tri, axis) - centroids.min[axis]) * scale));
+            binCount[bin]++;
+            binBounds[bin].merge(tri.v[0]);
+            binBounds[bin].merge(tri.v[1]);
+            binBounds[bin].merge(tri.v[2]);
+        }
+
+        // sweep from the right to get the cost of everything above each plane
+        float rightArea[SAH_BINS];
+        Ogre::uint32 rightCount[SAH_BINS];
+        Bounds right;
+        Ogre::uint32 n = 0;
+        for (int b = SAH_BINS - 1; b > 0; --b)
+        {
+            right.merge(binBounds[b]);
+            n += binCount[b];
+            rightArea[b] = right.area();
+            rightCount[b] = n;
+        }
+
+        Bounds left;
+        n = 0;
+        for (int b = 0; b < SAH_BINS - 1; ++b)
+        {
+            left.merge(binBounds[b]);
+            n += binCount[b];
+            if (n == 0 || rightCount[b + 1] == 0)
+                continue;
+            float cost = left.area() * n + rightArea[b + 1] * rightCount[b + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+        return; // splitting is not cheaper than testing all triangles
+
+    float scale = SAH_BINS / (centroids.max[bestAxis] - centroids.min[bestAxis]);
+    float minCentroid = centroids.min[bestAxis];
+    Triangle* mid = std::partition(&mTriangles[first], &mTriangles[first] + count, [&](const Triangle& tri) {
+        return std::min(SAH_BINS - 1, int((centroid(tri, bestAxis) - minCentroid) * scale)) <= bestSplit;
+    });
+    Ogre::uint32 leftCount = mid - &mTriangles[first];
+    if (leftCount == 0 || leftCount == count)
+        return;
+
+    Ogre::uint32 leftChild = mNodes.size();
+    mNodes.push_back(Node());
+    mNodes.push_back(Node());
+    mNodes[nodeIndex].first = leftChild;
+    mNodes[nodeIndex].count = 0;
+
+    buildNode(leftChild, first, leftCount);
+    buildNode(leftChild + 1, first + leftCount, count - leftCount);
+}
+
+bool TriangleBVH::raycast(const Ogre::Ray& ray, RaycastResult& result, Ogre::Real maxDistance) const
+{
+    if (mNodes.empty())
+        return false;
+
+    float origin[3], dir[3], invDir[3];
+    for (int a = 0; a < 3; ++a)
+    {
+        origin[a] = ray.getOrigin()[a];
+        dir[a] = ray.getDirection()[a];
+        invDir[a] = dir[a] != 0 ? 1.0f / dir[a] : std::numeric_limits<float>::max();
+    }
+
+    bool hit = false;
+    float closest = std::min<float>(maxDistance, std::numeric_limits<float>::max());
+
+    std::vector<Ogre::uint32> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node& node = mNodes[stack.back()];
+        stack.pop_back();
+        if (!intersectBox(node, origin, invDir, closest))
+            continue;
+
+        if (node.count)
+        {
+            for (Ogre::uint32 i = node.first; i < node.first + node.count; ++i)
+            {
+                float t;
+                if (intersectTriangle(mTriangles[i], origin, dir, t) && t < closest)
+                {
+                    closest = t;
+                    result.distance = t;
+                    result.subMesh = mTriangles[i].subMesh;
+                    result.face = mTriangles[i].face;
+                    hit = true;
+                }
+            }
+        }
+        else
+        {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+        }
+    }
+
+    return hit;
+}
+
+void TriangleBVH::exportBVH(const Ogre::String& filename) const
+{
+    std::ofstream ofs(filename.c_str(), std::ios::binary);
+    if (!ofs)
+    {
+        OGRE_EXCEPT(Ogre::Exception::ERR_CANNOT_WRITE_TO_FILE, "Unable to open file " + filename + " for writing",
+                    "TriangleBVH::exportBVH");
+    }
+
+    Ogre::uint32 header[5] = {BVH_MAGIC, BVH_VERSION, Ogre::uint32(subMeshBounds.size()), Ogre::uint32(mNodes.size()),
+                              Ogre::uint32(mTriangles.size())};
+    ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    for (const Ogre::AxisAlignedBox& box : subMeshBounds)
+    {
+        float extents[6] = {1, 1, 1, -1, -1, -1}; // inverted for submeshes without geometry
+        if (!box.isNull())
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                extents[a] = box.getMinimum()[a];
+                extents[a + 3] = box.getMaximum()[a];
+            }
+        }
+        ofs.write(reinterpret_cast<const char*>(extents), sizeof(extents));
+    }
+
+    ofs.write(reinterpret_cast<const char*>(mNodes.data()), mNodes.size() * sizeof(Node));
+    ofs.write(reinterpret_cast<const char*>(mTriangles.data()), mTriangles.size() * sizeof(Triangle));
+}
+
+void TriangleBVH::importBVH(const Ogre::DataStreamPtr& stream)
+{
+    clear();
+
+    Ogre::uint32 header[5];
+    if (stream->read(header, sizeof(header)) != sizeof(header) || header[0] != BVH_MAGIC || header[1] != BVH_VERSION)
+    {
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "'" + stream->getName() + "' is not a supported BVH file",
+                    "TriangleBVH::importBVH");
+    }
+
+    // the counts come from the file, so they must fit the stream before anything is allocated
+    const Ogre::uint64 expected = sizeof(header) + Ogre::uint64(header[2]) * 6 * sizeof(float) +
+                                  Ogre::uint64(header[3]) * sizeof(Node) + Ogre::uint64(header[4]) * sizeof(Triangle);
+    if (stream->size() && expected > stream->size())
+    {
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "'" + stream->getName() + "' is truncated",
+                    "TriangleBVH::importBVH");
+    }
+
+    subMeshBounds.resize(header[2]);
+    for (Ogre::AxisAlignedBox& box : subMeshBounds)
+    {
+        float extents[6];
+        if (stream->read(extents, sizeof(extents)) != sizeof(extents))
+        {
+            clear();
+            OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "'" + stream->getName() + "' is truncated",
+                        "TriangleBVH::importBVH");
+        }
+        if (extents[0] > extents[3])
+            continue;
+        box.setExtents(Ogre::Vector3(extents[0], extents[1], extents[2]), Ogre::Vector3(extents[3], extents[4], extents[5]));
+    }
+
+    // the layout on disk is the in memory layout, so no rebuild is needed
+    mNodes.resize(header[3]);
+    mTriangles.resize(header[4]);
+    size_t nodeBytes = mNodes.size() * sizeof(Node);
+    size_t triangleBytes = mTriangles.size() * sizeof(Triangle);
+    if (stream->read(mNodes.data(), nodeBytes) != nodeBytes ||
+        stream->read(mTriangles.data(), triangleBytes) != triangleBytes)
+    {
+        clear();
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "'" + stream->getName() + "' is truncated",
+                    "TriangleBVH::importBVH");
+    }
+
+    // raycast trusts the indices, children always follow their parent so there are no cycles
+    for (size_t i = 0; i < mNodes.size(); ++i)
+    {
+        const Node& node = mNodes[i];
+        bool valid = node.count ? node.first <= mTriangles.size() && node.count <= mTriangles.size() - node.first
+                                : node.first > i && node.first < mNodes.size() - 1;
+        if (!valid)
+        {
+            clear();
+            OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS,
+                        "'" + stream->getName() + "' has an invalid node " + Ogre::StringConverter::toString(i),
+                        "TriangleBVH::importBVH");
+        }
+    }
+}
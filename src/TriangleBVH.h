@@ -0,0 +1,100 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#ifndef __TriangleBVH_h__
+#define __TriangleBVH_h__
+
+#include <OgrePrerequisites.h>
+#include <OgreAxisAlignedBox.h>
+#include <OgreRay.h>
+#include <OgreMath.h>
+
+/** Bounding volume hierarchy over the triangles of a mesh
+
+    Built with the surface area heuristic during import and stored in a flat layout,
+    so a saved hierarchy can be read back and queried without any rebuild.
+*/
+class TriangleBVH
+{
+public:
+    struct Node
+    {
+        float min[3];
+        float max[3];
+        Ogre::uint32 first; // left child for inner nodes (right child follows it), first triangle for leaves
+        Ogre::uint32 count; // number of triangles, 0 for inner nodes
+    };
+
+    struct Triangle
+    {
+        float v[3][3];        // positions in mesh space
+        Ogre::uint32 subMesh; // index of the submesh the triangle belongs to
+        Ogre::uint32 face;    // index of the triangle inside the submesh index buffer
+    };
+
+    struct RaycastResult
+    {
+        Ogre::Real distance;
+        Ogre::uint32 subMesh;
+        Ogre::uint32 face;
+    };
+
+    /// builds the hierarchy, takes over the contents of triangles
+    void build(std::vector<Triangle>& triangles);
+    void clear();
+
+    bool isEmpty() const { return mNodes.empty(); }
+
+    /// finds the closest triangle hit by ray within maxDistance
+    bool raycast(const Ogre::Ray& ray, RaycastResult& result, Ogre::Real maxDistance = Ogre::Math::POS_INFINITY) const;
+
+    void exportBVH(const Ogre::String& filename) const;
+    /// throws if the file is truncated or its nodes do not form a valid hierarchy
+    void importBVH(const Ogre::DataStreamPtr& stream);
+
+    const std::vector<Node>& getNodes() const { return mNodes; }
+    const std::vector<Triangle>& getTriangles() const { return mTriangles; }
+
+    /// tight bounds of every submesh, indexed like Mesh::getSubMeshes
+    std::vector<Ogre::AxisAlignedBox> subMeshBounds;
+
+private:
+    void buildNode(Ogre::uint32 nodeIndex, Ogre::uint32 first, Ogre::uint32 count);
+
+    std::vector<Node> mNodes;
+    std::vector<Triangle> mTriangles;
+};
+
+#endif // __TriangleBVH_h__
@@ -0,0 +1,648 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of
+                                    _
+  ___   __ _ _ __ ___  __ _ ___ ___(_)_ __ ___  _ __
+ / _ \ / _` | '__/ _ \/ _` / __/ __| | '_ ` _ \| '_ \
+| (_) | (_| | | |  __/ (_| \__ \__ \ | | | | | | |_) |
+ \___/ \__, |_|  \___|\__,_|___/___/_|_| |_| |_| .__/
+       |___/                                   |_|
+
+For the latest info, see https://bitbucket.org/jacmoe/ogreassimp
+
+Copyright (c) 2011 Jacob 'jacmoe' Moen
+
+Licensed under the MIT license:
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include <Ogre.h>
+#include <OgreDefaultHardwareBufferManager.h>
+#include <OgreLodStrategyManager.h>
+#include <OgreScriptCompiler.h>
+
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/Exporter.hpp>
+#include <assimp/Importer.hpp>
+
+#include "AssimpLoader.h"
+#include "LogSink.h"
+#include "MeshBlobSerializer.h"
+#include "MeshPostProcess.h"
+
+/// reports a failed condition and lets the test go on
+#define CHECK(condition)                                                                       \
+    do                                                                                         \
+    {                                                                                          \
+        if (!(condition))                                                                      \
+        {                                                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            failures++;                                                                        \
+        }                                                                                      \
+    } while (0)
+
+namespace
+{
+int failures = 0;
+
+/// the managers the loader needs, created like the converter does without a render system
+struct TestEnvironment
+{
+    Ogre::LogManager* logMgr;
+    Ogre::ResourceGroupManager* rgm;
+    Ogre::Math* mth;
+    Ogre::LodStrategyManager* lodMgr;
+    Ogre::MeshManager* meshMgr;
+    Ogre::MaterialManager* matMgr;
+    Ogre::SkeletonManager* skelMgr;
+    Ogre::DefaultHardwareBufferManager* bufferManager;
+    Ogre::ScriptCompilerManager* scmgr;
+
+    TestEnvironment()
+    {
+        logMgr = new Ogre::LogManager();
+        logMgr->createLog("OgreAssimpTests.log", true, false, false);
+        rgm = new Ogre::ResourceGroupManager();
+        mth = new Ogre::Math();
+        lodMgr = new Ogre::LodStrategyManager();
+        meshMgr = new Ogre::MeshManager();
+        matMgr = new Ogre::MaterialManager();
+        matMgr->initialise();
+        skelMgr = new Ogre::SkeletonManager();
+        bufferManager = new Ogre::DefaultHardwareBufferManager();
+        scmgr = new Ogre::ScriptCompilerManager();
+    }
+
+    ~TestEnvironment()
+    {
+        // like the converter, the MeshManager is left alive
+        delete skelMgr;
+        delete matMgr;
+        delete bufferManager;
+        delete scmgr;
+        delete lodMgr;
+        delete mth;
+        delete rgm;
+        LogSink::getSingleton().shutdown();
+        delete logMgr;
+    }
+};
+
+const Ogre::Vector3 SPINE_OFFSET(0, 0, 0.5f);
+const Ogre::Vector3 LEG_OFFSET(0, 0.25f, 1);
+
+aiNode* createNode(const char* name, const aiVector3D& position)
+{
+    aiNode* node = new aiNode(name);
+    aiMatrix4x4::Translation(position, node->mTransformation);
+    return node;
+}
+
+void setChildren(aiNode* parent, std::initializer_list<aiNode*> children)
+{
+    parent->mNumChildren = unsigned(children.size());
+    parent->mChildren = new aiNode*[children.size()];
+    std::copy(children.begin(), children.end(), parent->mChildren);
+    for (aiNode* child : children)
+        child->mParent = parent;
+}
+
+aiBone* createBone(const char* name, const aiVector3D& globalPosition, std::initializer_list<unsigned int> vertices)
+{
+    aiBone* bone = new aiBone();
+    bone->mName = name;
+    aiMatrix4x4::Translation(-globalPosition, bone->mOffsetMatrix);
+    bone->mNumWeights = unsigned(vertices.size());
+    bone->mWeights = new aiVertexWeight[vertices.size()];
+    unsigned int i = 0;
+    for (unsigned int v : vertices)
+        bone->mWeights[i++] = aiVertexWeight(v, 1);
+    return bone;
+}
+
+/// a channel moving the node from its bind position by offset over the clip
+aiNodeAnim* createChannel(const char* name, const aiVector3D& bindPosition, const Ogre::Vector3& offset, double duration)
+{
+    aiNodeAnim* channel = new aiNodeAnim();
+    channel->mNodeName = name;
+    channel->mNumPositionKeys = 2;
+    channel->mPositionKeys = new aiVectorKey[2];
+    channel->mPositionKeys[0] = aiVectorKey(0, bindPosition);
+    channel->mPositionKeys[1] = aiVectorKey(duration, bindPosition + aiVector3D(offset.x, offset.y, offset.z));
+    channel->mNumRotationKeys = 1;
+    channel->mRotationKeys = new aiQuatKey[1];
+    channel->mRotationKeys[0] = aiQuatKey(0, aiQuaternion());
+    channel->mNumScalingKeys = 1;
+    channel->mScalingKeys = new aiVectorKey[1];
+    channel->mScalingKeys[0] = aiVectorKey(0, aiVector3D(1, 1, 1));
+    return channel;
+}
+
+/** a quad skinned to spine and leg of the hierarchy root > hip > spine, leg, plus the
+    one second clip "walk" moving spine by SPINE_OFFSET and leg by LEG_OFFSET
+
+    The channels are listed leaf first, so their order differs from the bone handles.
+*/
+aiScene* createSkinnedScene()
+{
+    aiScene* scene = new aiScene();
+    scene->mRootNode = new aiNode("root");
+    aiNode* body = new aiNode("body");
+    body->mNumMeshes = 1;
+    body->mMeshes = new unsigned int[1];
+    body->mMeshes[0] = 0;
+    aiNode* hip = createNode("hip", aiVector3D(0, 1, 0));
+    aiNode* spine = createNode("spine", aiVector3D(0, 1, 0));
+    aiNode* leg = createNode("leg", aiVector3D(0, -1, 0));
+    setChildren(scene->mRootNode, {body, hip});
+    setChildren(hip, {spine, leg});
+
+    aiMesh* mesh = new aiMesh();
+    mesh->mName = "quad";
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumVertices = 4;
+    mesh->mVertices = new aiVector3D[4];
+    mesh->mNormals = new aiVector3D[4];
+    mesh->mTextureCoords[0] = new aiVector3D[4];
+    mesh->mNumUVComponents[0] = 2;
+    for (unsigned int v = 0; v < 4; ++v)
+    {
+        float x = (v == 1 || v == 2) ? 1.0f : 0.0f;
+        float y = v >= 2 ? 1.0f : 0.0f;
+        mesh->mVertices[v] = aiVector3D(x * 2 - 1, y * 2, 0);
+        mesh->mNormals[v] = aiVector3D(0, 0, 1);
+        mesh->mTextureCoords[0][v] = aiVector3D(x, y, 0);
+    }
+    mesh->mNumFaces = 2;
+    mesh->mFaces = new aiFace[2];
+    const unsigned int indices[2][3] = {{0, 1, 2}, {0, 2, 3}};
+    for (unsigned int f = 0; f < 2; ++f)
+    {
+        mesh->mFaces[f].mNumIndices = 3;
+        mesh->mFaces[f].mIndices = new unsigned int[3];
+        std::copy(indices[f], indices[f] + 3, mesh->mFaces[f].mIndices);
+    }
+    mesh->mNumBones = 2;
+    mesh->mBones = new aiBone*[2];
+    mesh->mBones[0] = createBone("spine", aiVector3D(0, 2, 0), {2, 3});
+    mesh->mBones[1] = createBone("leg", aiVector3D(0, 0, 0), {0, 1});
+
+    scene->mNumMeshes = 1;
+    scene->mMeshes = new aiMesh*[1];
+    scene->mMeshes[0] = mesh;
+    scene->mNumMaterials = 1;
+    scene->mMaterials = new aiMaterial*[1];
+    scene->mMaterials[0] = new aiMaterial();
+
+    aiAnimation* anim = new aiAnimation();
+    anim->mName = "walk";
+    anim->mTicksPerSecond = 10;
+    anim->mDuration = 10;
+    anim->mNumChannels = 2;
+    anim->mChannels = new aiNodeAnim*[2];
+    anim->mChannels[0] = createChannel("leg", aiVector3D(0, -1, 0), LEG_OFFSET, anim->mDuration);
+    anim->mChannels[1] = createChannel("spine", aiVector3D(0, 1, 0), SPINE_OFFSET, anim->mDuration);
+    scene->mNumAnimations = 1;
+    scene->mAnimations = new aiAnimation*[1];
+    scene->mAnimations[0] = anim;
+    return scene;
+}
+
+/// scene as a stream the loader reads with the type "assbin"
+Ogre::DataStreamPtr exportScene(const aiScene* scene)
+{
+    Assimp::Exporter exporter;
+    const aiExportDataBlob* blob = exporter.ExportToBlob(scene, "assbin");
+    if (!blob)
+        OGRE_EXCEPT(Ogre::Exception::ERR_INTERNAL_ERROR, exporter.GetErrorString(), "exportScene");
+
+    // the exporter owns the blob
+    Ogre::MemoryDataStreamPtr stream(new Ogre::MemoryDataStream(blob->size));
+    memcpy(stream->getPtr(), blob->data, blob->size);
+    return stream;
+}
+
+AssimpLoader::Options testOptions()
+{
+    AssimpLoader::Options options;
+    options.params = AssimpLoader::LP_QUIET_MODE | AssimpLoader::LP_SKIP_MATERIALS;
+    return options;
+}
+
+Ogre::MeshPtr loadScene(AssimpLoader& loader, const aiScene* scene, Ogre::SkeletonPtr& skeleton,
+                        const AssimpLoader::Options& options = testOptions())
+{
+    static int meshCount = 0;
+    Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().createManual(
+        "test" + Ogre::StringConverter::toString(meshCount++) + ".mesh", Ogre::RGN_DEFAULT);
+    CHECK(loader.load(exportScene(scene), "assbin", mesh.get(), skeleton, options));
+    return mesh;
+}
+
+/// applies the end of the clip "walk" and checks that every bone moved as createSkinnedScene intends
+void checkWalk(Ogre::Skeleton* skeleton)
+{
+    CHECK(skeleton->hasAnimation("walk"));
+    if (!skeleton->hasAnimation("walk"))
+        return;
+
+    // Animation::apply looks the bones up by track handle
+    Ogre::Animation* anim = skeleton->getAnimation("walk");
+    for (const auto& entry : anim->_getNodeTrackList())
+        CHECK(entry.second->getAssociatedNode() == skeleton->getBone(entry.first));
+
+    std::map<Ogre::String, Ogre::Vector3> before;
+    for (unsigned short i = 0; i < skeleton->getNumBones(); ++i)
+        before[skeleton->getBone(i)->getName()] = skeleton->getBone(i)->getPosition();
+
+    anim->apply(skeleton, anim->getLength());
+
+    for (unsigned short i = 0; i < skeleton->getNumBones(); ++i)
+    {
+        const Ogre::Bone* bone = skeleton->getBone(i);
+        Ogre::Vector3 offset = bone->getName() == "spine" ? SPINE_OFFSET : bone->getName() == "leg" ? LEG_OFFSET : Ogre::Vector3::ZERO;
+        CHECK(bone->getPosition().positionEquals(before[bone->getName()] + offset, 1e-4f));
+    }
+}
+
+void testTrackBinding()
+{
+    std::unique_ptr<aiScene> scene(createSkinnedScene());
+    AssimpLoader loader;
+    Ogre::SkeletonPtr skeleton;
+    loadScene(loader, scene.get(), skeleton);
+    CHECK(skeleton);
+    if (!skeleton)
+        return;
+    checkWalk(skeleton.get());
+
+    // split clips keep driving the same bones
+    std::vector<Ogre::SkeletonPtr> split;
+    AssimpLoader::splitAnimations(skeleton, AssimpLoader::AnimationGroups(), split);
+    CHECK(split.size() == 1);
+    if (split.size() == 1)
+        checkWalk(split[0].get());
+}
+
+void testAppendAnimations()
+{
+    std::unique_ptr<aiScene> scene(createSkinnedScene());
+    AssimpLoader::Options options = testOptions();
+    options.animations.push_back("none");
+    AssimpLoader loader;
+    Ogre::SkeletonPtr skeleton;
+    loadScene(loader, scene.get(), skeleton, options);
+    CHECK(skeleton && !skeleton->hasAnimation("walk"));
+    if (!skeleton)
+        return;
+
+    // renamed channels are bound to the bones they were renamed to
+    scene->mAnimations[0]->mChannels[0]->mNodeName = "Leg_Anim";
+    AssimpLoader::Options append = testOptions();
+    append.boneNameMap["Leg_Anim"] = "leg";
+    CHECK(loader.loadAnimations(exportScene(scene.get()), "assbin", skeleton, append));
+    checkWalk(skeleton.get());
+
+    // the clips of a shared skeleton are part of its name
+    std::unique_ptr<aiScene> other(createSkinnedScene());
+    AssimpLoader::Options share = testOptions();
+    share.params |= AssimpLoader::LP_SHARE_SKELETONS;
+    share.animations.push_back("none");
+    Ogre::SkeletonPtr shared;
+    loadScene(loader, other.get(), shared, share);
+    CHECK(shared);
+    if (!shared)
+        return;
+    CHECK(!loader.loadAnimations(exportScene(scene.get()), "assbin", shared, append));
+    CHECK(!shared->hasAnimation("walk"));
+}
+
+/// contents of a vertex or index buffer
+template <typename BufferPtr> std::vector<Ogre::uint8> readBuffer(const BufferPtr& buffer)
+{
+    std::vector<Ogre::uint8> data(buffer->getSizeInBytes());
+    buffer->readData(0, data.size(), data.data());
+    return data;
+}
+
+void checkSameVertexData(const Ogre::VertexData* a, const Ogre::VertexData* b)
+{
+    CHECK(a->vertexStart == b->vertexStart && a->vertexCount == b->vertexCount);
+    CHECK(a->vertexDeclaration->getElements() == b->vertexDeclaration->getElements());
+    const Ogre::VertexBufferBinding::VertexBufferBindingMap& bindings = a->vertexBufferBinding->getBindings();
+    CHECK(bindings.size() == b->vertexBufferBinding->getBindings().size());
+    for (const auto& binding : bindings)
+    {
+        CHECK(b->vertexBufferBinding->isBufferBound(binding.first));
+        if (b->vertexBufferBinding->isBufferBound(binding.first))
+            CHECK(readBuffer(binding.second) == readBuffer(b->vertexBufferBinding->getBuffer(binding.first)));
+    }
+}
+
+void testBlobRoundTrip()
+{
+    std::unique_ptr<aiScene> scene(createSkinnedScene());
+    AssimpLoader loader;
+    Ogre::SkeletonPtr skeleton;
+    Ogre::MeshPtr mesh = loadScene(loader, scene.get(), skeleton);
+
+    const Ogre::String filename = "blob_round_trip.blob";
+    MeshBlobSerializer::exportMesh(mesh.get(), filename);
+    Ogre::MeshPtr imported = Ogre::MeshManager::getSingleton().createManual("blob_round_trip.mesh", Ogre::RGN_DEFAULT);
+    MeshBlobSerializer::importMesh(filename, imported.get());
+
+    CHECK(imported->getNumSubMeshes() == mesh->getNumSubMeshes());
+    CHECK(imported->getSkeletonName() == mesh->getSkeletonName());
+    CHECK(imported->getBounds().getMinimum() == mesh->getBounds().getMinimum());
+    CHECK(imported->getBounds().getMaximum() == mesh->getBounds().getMaximum());
+    for (unsigned short i = 0; i < std::min(imported->getNumSubMeshes(), mesh->getNumSubMeshes()); ++i)
+    {
+        const Ogre::SubMesh* a = mesh->getSubMesh(i);
+        const Ogre::SubMesh* b = imported->getSubMesh(i);
+        CHECK(a->getMaterialName() == b->getMaterialName());
+        CHECK(a->useSharedVertices == b->useSharedVertices);
+        CHECK(a->blendIndexToBoneIndexMap == b->blendIndexToBoneIndexMap);
+        if (!a->useSharedVertices && !b->useSharedVertices)
+            checkSameVertexData(a->vertexData, b->vertexData);
+        CHECK(a->indexData->indexCount == b->indexData->indexCount);
+        CHECK(readBuffer(a->indexData->indexBuffer) == readBuffer(b->indexData->indexBuffer));
+    }
+
+    // corrupt blobs fail with an Ogre exception and leave the mesh untouched
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    const std::vector<char> blob((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto checkRejected = [](const std::vector<char>& data, const char* name, bool verify) {
+        Ogre::MeshPtr corrupt = Ogre::MeshManager::getSingleton().createManual(
+            Ogre::StringUtil::format("blob_%s_%d.mesh", name, int(verify)), Ogre::RGN_DEFAULT);
+        bool thrown = false;
+        try
+        {
+            MeshBlobSerializer::importMesh(data.data(), data.size(), corrupt.get(), verify);
+        }
+        catch (Ogre::Exception&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(corrupt->getNumSubMeshes() == 0 && !corrupt->sharedVertexData);
+    };
+
+    std::vector<char> badVertexData = blob;
+    const size_t sharedVertexDataAt = 32; // Header::sharedVertexData
+    const Ogre::uint32 badIndex = 7;
+    memcpy(&badVertexData[sharedVertexDataAt], &badIndex, sizeof(badIndex));
+    for (bool verify : {true, false})
+        checkRejected(badVertexData, "bad_vertex_data", verify);
+
+    // in the last submesh, so the earlier ones would already exist
+    std::vector<char> badIndexSize = blob;
+    const size_t subMeshOffsetAt = 40, subMeshEntrySize = 48, indexSizeAt = 16; // Header::subMeshOffset, SubMeshEntry::indexSize
+    Ogre::uint64 subMeshOffset;
+    memcpy(&subMeshOffset, &blob[subMeshOffsetAt], sizeof(subMeshOffset));
+    const Ogre::uint32 eightBytes = 8;
+    memcpy(&badIndexSize[subMeshOffset + (mesh->getNumSubMeshes() - 1) * subMeshEntrySize + indexSizeAt], &eightBytes,
+           sizeof(eightBytes));
+    checkRejected(badIndexSize, "bad_index_size", false);
+}
+
+void testBVHImport()
+{
+    std::unique_ptr<aiScene> scene(createSkinnedScene());
+    AssimpLoader::Options options = testOptions();
+    options.params |= AssimpLoader::LP_BUILD_BVH;
+    AssimpLoader loader;
+    Ogre::SkeletonPtr skeleton;
+    loadScene(loader, scene.get(), skeleton, options);
+    const Ogre::String filename = "bvh_import.bvh";
+    loader.getBVH().exportBVH(filename);
+
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    std::vector<char> bvh((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto import = [](std::vector<char> data) {
+        TriangleBVH imported;
+        Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream(data.data(), data.size()));
+        try
+        {
+            imported.importBVH(stream);
+        }
+        catch (Ogre::Exception&)
+        {
+            return false;
+        }
+        return !imported.isEmpty();
+    };
+    CHECK(import(bvh));
+
+    // header, then the bounds of the one submesh, then the root, a leaf here
+    const size_t rootFirstAt = 5 * sizeof(Ogre::uint32) + 6 * sizeof(float) + 6 * sizeof(float);
+    std::vector<char> corrupt = bvh;
+    const Ogre::uint32 badFirst = 1000;
+    memcpy(&corrupt[rootFirstAt], &badFirst, sizeof(badFirst));
+    CHECK(!import(corrupt));
+
+    std::vector<char> truncated(bvh.begin(), bvh.end() - sizeof(TriangleBVH::Triangle));
+    CHECK(!import(truncated));
+}
+
+/// names the material of createSkinnedScene, so reloads find it again, and sets its diffuse colour
+void setMaterial(aiScene* scene, const aiColor4D& diffuse)
+{
+    delete scene->mMaterials[0];
+    scene->mMaterials[0] = new aiMaterial();
+    aiString name("skin");
+    scene->mMaterials[0]->AddProperty(&name, AI_MATKEY_NAME);
+    scene->mMaterials[0]->AddProperty(&diffuse, 1, AI_MATKEY_COLOR_DIFFUSE);
+}
+
+void testReimport()
+{
+    std::unique_ptr<aiScene> scene(createSkinnedScene());
+    setMaterial(scene.get(), aiColor4D(1, 0, 0, 1));
+    AssimpLoader::Options options;
+    options.params = AssimpLoader::LP_QUIET_MODE;
+    AssimpLoader loader;
+    Ogre::SkeletonPtr skeleton;
+    Ogre::MeshPtr mesh = loadScene(loader, scene.get(), skeleton, options);
+    CHECK(skeleton && mesh->getNumSubMeshes() == 1);
+    if (!skeleton || mesh->getNumSubMeshes() != 1)
+        return;
+
+    Ogre::SubMesh* subMesh = mesh->getSubMesh(0);
+    const Ogre::VertexData* vertexData = subMesh->vertexData;
+    const Ogre::HardwareVertexBuffer* positions = vertexData->vertexBufferBinding->getBuffer(0).get();
+    const std::vector<Ogre::uint8> before = readBuffer(vertexData->vertexBufferBinding->getBuffer(0));
+    Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().getByName(subMesh->getMaterialName(), Ogre::RGN_DEFAULT);
+    CHECK(material && material->getTechnique(0)->getPass(0)->getDiffuse() == Ogre::ColourValue::Red);
+    if (!material)
+        return;
+
+    // a cancelled reimport leaves geometry and materials alone
+    scene->mMeshes[0]->mVertices[3].z = 0.5f;
+    setMaterial(scene.get(), aiColor4D(0, 1, 0, 1));
+    AssimpLoader::Options cancelled = options;
+    cancelled.progress = [](AssimpLoader::LoadPhase, float) { return false; };
+    AssimpLoader::ReimportResult result;
+    CHECK(!loader.reimport(exportScene(scene.get()), "assbin", mesh.get(), skeleton, result, cancelled));
+    CHECK(material->getTechnique(0)->getPass(0)->getDiffuse() == Ogre::ColourValue::Red);
+    CHECK(readBuffer(vertexData->vertexBufferBinding->getBuffer(0)) == before);
+
+    // the same vertex count and layout is written into the existing buffers
+    CHECK(loader.reimport(exportScene(scene.get()), "assbin", mesh.get(), skeleton, result, options));
+    CHECK(result.subMeshesUpdated == 1 && result.animationsUnchanged == 1 && result.materialsUpdated == 1);
+    CHECK(!result.rebuilt);
+    CHECK(mesh->getSubMesh(0) == subMesh && subMesh->vertexData == vertexData);
+    CHECK(vertexData->vertexBufferBinding->getBuffer(0).get() == positions);
+    CHECK(readBuffer(vertexData->vertexBufferBinding->getBuffer(0)) != before);
+    CHECK(material->getTechnique(0)->getPass(0)->getDiffuse() == Ogre::ColourValue::Green);
+    checkWalk(skeleton.get());
+
+    // another bind pose replaces the skeleton, which keeps its name
+    const Ogre::String skeletonName = skeleton->getName();
+    aiMatrix4x4::Translation(aiVector3D(0, 1.5f, 0), scene->mRootNode->mChildren[1]->mTransformation);
+    CHECK(loader.reimport(exportScene(scene.get()), "assbin", mesh.get(), skeleton, result, options));
+    CHECK(result.rebuilt);
+    CHECK(skeleton->getName() == skeletonName && mesh->getSkeletonName() == skeletonName);
+    CHECK(Ogre::SkeletonManager::getSingleton().getByName(skeletonName, Ogre::RGN_DEFAULT) == skeleton);
+    CHECK(skeleton->getBone("hip")->getPosition().positionEquals(Ogre::Vector3(0, 1.5f, 0), 1e-4f));
+    checkWalk(skeleton.get());
+}
+/// a curved 3x3 heightfield with a vertex per face corner, as importers produce before joining
+aiScene* createHeightfieldScene()
+{
+    const unsigned int cells = 3;
+    aiMesh* mesh = new aiMesh();
+    mesh->mName = "heightfield";
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumFaces = cells * cells * 2;
+    mesh->mNumVertices = mesh->mNumFaces * 3;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+    mesh->mNumUVComponents[0] = 2;
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+
+    const unsigned int corners[2][3][2] = {{{0, 0}, {1, 0}, {1, 1}}, {{0, 0}, {1, 1}, {0, 1}}};
+    unsigned int v = 0;
+    for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+    {
+        const unsigned int cell = f / 2;
+        mesh->mFaces[f].mNumIndices = 3;
+        mesh->mFaces[f].mIndices = new unsigned int[3];
+        for (unsigned int i = 0; i < 3; ++i, ++v)
+        {
+            float x = float(cell % cells + corners[f % 2][i][0]);
+            float y = float(cell / cells + corners[f % 2][i][1]);
+            mesh->mVertices[v] = aiVector3D(x, y, 0.05f * (x * x + x * y - y * y));
+            mesh->mTextureCoords[0][v] = aiVector3D(x / cells, y / cells, 0);
+            mesh->mFaces[f].mIndices[i] = v;
+        }
+    }
+
+    aiScene* scene = new aiScene();
+    scene->mRootNode = new aiNode("root");
+    scene->mRootNode->mNumMeshes = 1;
+    scene->mRootNode->mMeshes = new unsigned int[1];
+    scene->mRootNode->mMeshes[0] = 0;
+    scene->mNumMeshes = 1;
+    scene->mMeshes = new aiMesh*[1];
+    scene->mMeshes[0] = mesh;
+    scene->mNumMaterials = 1;
+    scene->mMaterials = new aiMaterial*[1];
+    scene->mMaterials[0] = new aiMaterial();
+    return scene;
+}
+
+void testParallelPostProcess()
+{
+    std::unique_ptr<aiScene> scene(createHeightfieldScene());
+    Ogre::DataStreamPtr stream = exportScene(scene.get());
+    std::vector<char> data(stream->size());
+    stream->read(data.data(), data.size());
+
+    // Assimp's serial steps against MeshPostProcess, with the UVs flipped first in both
+    Assimp::Importer serial, parallel;
+    const aiScene* expected = serial.ReadFileFromMemory(data.data(), data.size(),
+                                                        aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace, "assbin");
+    const aiScene* actual = parallel.ReadFileFromMemory(data.data(), data.size(), aiProcess_FlipUVs, "assbin");
+    CHECK(expected && actual);
+    if (!expected || !actual)
+        return;
+
+    aiMesh* mesh = actual->mMeshes[0];
+    MeshPostProcess::generateSmoothNormals(mesh, 175);
+    MeshPostProcess::calcTangentSpace(mesh);
+    const aiMesh* reference = expected->mMeshes[0];
+    CHECK(mesh->mNumVertices == reference->mNumVertices && mesh->mTangents && reference->mTangents);
+    if (mesh->mNumVertices != reference->mNumVertices || !mesh->mTangents || !reference->mTangents)
+        return;
+
+    // Assimp averages the tangents after projecting them, so those only agree within a few degrees
+    for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+    {
+        CHECK(mesh->mNormals[v] * reference->mNormals[v] > 0.9999f);
+        CHECK(mesh->mTangents[v] * reference->mTangents[v] > 0.99f);
+        CHECK(mesh->mBitangents[v] * reference->mBitangents[v] > 0.99f);
+    }
+}
+}
+
+int main(int numargs, char** args)
+{
+    std::map<Ogre::String, std::function<void()> > tests;
+    tests["track_binding"] = testTrackBinding;
+    tests["append_animations"] = testAppendAnimations;
+    tests["blob_round_trip"] = testBlobRoundTrip;
+    tests["bvh_import"] = testBVHImport;
+    tests["reimport"] = testReimport;
+    tests["parallel_postprocess"] = testParallelPostProcess;
+
+    if (numargs >= 2 && !tests.count(args[1]))
+    {
+        std::cerr << "unknown test " << args[1] << std::endl;
+        return 1;
+    }
+
+    TestEnvironment environment;
+    for (const auto& test : tests)
+    {
+        if (numargs < 2 || test.first == args[1])
+        {
+            try
+            {
+                test.second();
+            }
+            catch (Ogre::Exception& e)
+            {
+                std::cerr << test.first << ": " << e.getDescription() << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -34,7 +34,25 @@ THE SOFTWARE.
 -----------------------------------------------------------------------------
 */
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <sys/stat.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <unistd.h>
+extern char** environ;
+#endif
 
 #include <Ogre.h>
 #include <OgreString.h>
@@ -44,8 +62,21 @@ THE SOFTWARE.
 #include <OgreScriptCompiler.h>
 #include <OgreFileSystem.h>
 #include <OgreLodStrategyManager.h>
+#if OGRE_VERSION < ((1 << 16) | (11 << 8) | 0) && OGRE_NO_FREEIMAGE == 0
+// later versions ship the image codecs as plugins only
+#include <OgreFreeImageCodec.h>
+#define HAVE_FREEIMAGE_CODEC
+#elif defined(HAVE_STBI_CODEC)
+#include <OgreSTBICodec.h>
+#endif
+
+#include <assimp/Importer.hpp>
 
 #include "AssimpLoader.h"
+#include "LogSink.h"
+#include "MeshBlobSerializer.h"
+#include "SceneCache.h"
+#include "TextureAtlas.h"
 
 namespace
 {
@@ -79,11 +110,58 @@ void help(void)
     std::cout << std::endl << "Available options:" << std::endl;
     std::cout << "-q                  = Quiet mode, less output" << std::endl;
     std::cout << "-log filename       = name of the log file (default: 'OgreAssimp.log')" << std::endl;
+    std::cout << "-verbosity n        = 0 errors, 1 per file, 2 per material and clip, 3 per node, bone and submesh" << std::endl;
+    std::cout << "                      (default: '3')" << std::endl;
+    std::cout << "-summarise_log      = Count the per node, bone, channel and submesh messages instead of logging them" << std::endl;
     std::cout << "-aniSpeedMod value  = Factor to scale the animation speed - (default: '1.0')" << std::endl;
     std::cout << "                      (double between 0 and 1)" << std::endl;
     std::cout << "-3ds_ani_fix        = Fix for the fact that 3ds max exports the animation over a" << std::endl;
     std::cout << "                      longer time frame than the animation actually plays for" << std::endl;
     std::cout << "-max_edge_angle deg = When normals are generated, max angle between two faces to smooth over" << std::endl;
+    std::cout << "-split16            = Split meshes needing 32 bit indices into submeshes with 16 bit indices" << std::endl;
+    std::cout << "-blob               = Also write the mesh as a memory mappable blob (basename.meshblob)" << std::endl;
+    std::cout << "-bvh                = Write a triangle BVH for picking next to the mesh (basename.bvh)" << std::endl;
+    std::cout << "-prune_bones        = Remove bones without vertex weights or animation" << std::endl;
+    std::cout << "-max_influences n   = Maximum bone weights per vertex, 1, 2 or 4 (default: '4')" << std::endl;
+    std::cout << "-quantise_weights   = Round bone weights to 8 bit. Only the rounding is exported, Ogre compiles" << std::endl;
+    std::cout << "                      float weights when loading the .mesh" << std::endl;
+    std::cout << "-max_palette n      = Split skinned submeshes to use at most n bones each (default: '0', no limit)" << std::endl;
+    std::cout << "-share_skeletons    = Name skeletons after the hash of their bones and clips, so meshes" << std::endl;
+    std::cout << "                      skinned to the same rig link to one skeleton file" << std::endl;
+    std::cout << "-anims a,b          = Only import the named animation clips" << std::endl;
+    std::cout << "-split_anims        = Write the bind pose skeleton and one animation-only skeleton per clip" << std::endl;
+    std::cout << "-anim_groups spec   = With -split_anims, group clips into one skeleton each" << std::endl;
+    std::cout << "                      (e.g. 'locomotion:walk,run;combat:punch,kick')" << std::endl;
+    std::cout << "-anims_onto file    = Append the animation clips of the source to an existing .skeleton file" << std::endl;
+    std::cout << "                      instead of converting it, channels are matched to bones by name" << std::endl;
+    std::cout << "-bone_map file      = With -anims_onto, rename channels to bones, one 'channel bone' pair per line" << std::endl;
+    std::cout << "-node_filter pat    = Only import meshes below nodes matching the glob pattern" << std::endl;
+    std::cout << "-mesh_filter pat    = Only import meshes whose name matches the glob pattern" << std::endl;
+    std::cout << "-regex              = The filter patterns are regular expressions" << std::endl;
+    std::cout << "-no_materials       = Do not import materials" << std::endl;
+    std::cout << "-no_normals         = Do not import or generate normals" << std::endl;
+    std::cout << "-no_uvs             = Do not import or generate texture coordinates" << std::endl;
+    std::cout << "-geometry_only      = Only import positions and indices" << std::endl;
+    std::cout << "-animations_only    = Only import the skeleton and animations" << std::endl;
+    std::cout << "-tangents           = Write the imported tangents, handedness in w" << std::endl;
+    std::cout << "-tangent_format f   = Packing of the tangents, short4 or int10 (default: 'short4')" << std::endl;
+    std::cout << "-chunk_size s       = Write static geometry as one mesh per grid cell of size s plus an index" << std::endl;
+    std::cout << "                      (basename.chunks)" << std::endl;
+    std::cout << "-atlas size         = Pack the diffuse textures of compatible materials into atlases of at most" << std::endl;
+    std::cout << "                      size pixels (rounded down to a power of two) and merge their materials and submeshes (needs an image codec)" << std::endl;
+    std::cout << "-edge_lists         = Build the edge lists of all LODs for stencil shadows and write them with" << std::endl;
+    std::cout << "                      the mesh, warns about non-manifold geometry" << std::endl;
+    std::cout << "-threads n          = Threads preparing the submeshes (default: '0', one per core)" << std::endl;
+    std::cout << "-parallel_postprocess = Generate normals and tangents and join vertices on all threads" << std::endl;
+    std::cout << "                      instead of with Assimp's serial steps" << std::endl;
+    std::cout << "-low_memory         = Free the imported data while converting, for very large files" << std::endl;
+    std::cout << "-bench n            = Load the source n times without writing anything and report the load rate" << std::endl;
+    std::cout << "-scene_cache MB     = Keep up to MB of imported scenes in memory and reuse them when the same" << std::endl;
+    std::cout << "                      source is loaded again with the same import settings (default: '0', off)" << std::endl;
+    std::cout << "-incremental        = Only convert if the source, its auxiliary files or the options changed." << std::endl;
+    std::cout << "                      sourcefile may be a directory, stale files are converted in parallel" << std::endl;
+    std::cout << "-watch              = Like -incremental, but keep watching for changes" << std::endl;
+    std::cout << "-j n                = Number of parallel conversions for -incremental (default: number of cores)" << std::endl;
     std::cout << "sourcefile          = name of file to convert" << std::endl;
     std::cout << "destination         = optional name of directory to write to. If you don't" << std::endl;
     std::cout << "                      specify this the converter will use the same directory as the sourcefile."  << std::endl;
@@ -98,9 +176,34 @@ struct AssOptions
 
     AssimpLoader::Options options;
 
+    bool splitAnimations;
+    bool writeBlob;
+    bool buildEdgeLists;
+    unsigned int atlasSize;
+    AssimpLoader::AnimationGroups animationGroups;
+    /// skeleton file the clips are appended to, converting nothing else
+    Ogre::String animationTarget;
+
+    bool incremental;
+    bool watch;
+    unsigned int benchLoads;
+    unsigned int jobs;
+    /// options affecting the output, recorded in the .deps file
+    Ogre::String signature;
+    /// arguments of the child process converting a single file of a directory
+    Ogre::StringVector childArgs;
+
     AssOptions()
     {
         logFile = "OgreAssimp.log";
+        splitAnimations = false;
+        writeBlob = false;
+        buildEdgeLists = false;
+        atlasSize = 0;
+        incremental = false;
+        watch = false;
+        benchLoads = 0;
+        jobs = 0;
     };
 };
 
@@ -118,13 +221,71 @@ AssOptions parseArgs(int numArgs, char **args)
 
     unOpt["-q"] = false;
     unOpt["-3ds_ani_fix"] = false;
+    unOpt["-split16"] = false;
+    unOpt["-bvh"] = false;
+    unOpt["-blob"] = false;
+    unOpt["-prune_bones"] = false;
+    unOpt["-quantise_weights"] = false;
+    unOpt["-split_anims"] = false;
+    unOpt["-regex"] = false;
+    unOpt["-no_materials"] = false;
+    unOpt["-no_normals"] = false;
+    unOpt["-no_uvs"] = false;
+    unOpt["-geometry_only"] = false;
+    unOpt["-animations_only"] = false;
+    unOpt["-low_memory"] = false;
+    unOpt["-tangents"] = false;
+    unOpt["-share_skeletons"] = false;
+    unOpt["-edge_lists"] = false;
+    unOpt["-parallel_postprocess"] = false;
+    unOpt["-summarise_log"] = false;
+    unOpt["-incremental"] = false;
+    unOpt["-watch"] = false;
     binOpt["-log"] = opts.logFile;
+    binOpt["-verbosity"] = "3";
+    binOpt["-j"] = "0";
     binOpt["-aniName"] = "";
     binOpt["-aniSpeedMod"] = "1.0";
     binOpt["-max_edge_angle"] = "30";
+    binOpt["-max_influences"] = "4";
+    binOpt["-max_palette"] = "0";
+    binOpt["-anims"] = "";
+    binOpt["-anim_groups"] = "";
+    binOpt["-node_filter"] = "";
+    binOpt["-mesh_filter"] = "";
+    binOpt["-tangent_format"] = "short4";
+    binOpt["-threads"] = "0";
+    binOpt["-chunk_size"] = "0";
+    binOpt["-atlas"] = "0";
+    binOpt["-anims_onto"] = "";
+    binOpt["-bone_map"] = "";
+    binOpt["-bench"] = "0";
+    binOpt["-scene_cache"] = "0";
 
     int startIndex = Ogre::findCommandLineOpts(numArgs, args, unOpt, binOpt);
 
+    opts.childArgs.push_back(args[0]);
+    opts.childArgs.push_back("-incremental");
+    for (int i = 1; i < startIndex; ++i)
+    {
+        Ogre::String arg = args[i];
+        bool hasValue = binOpt.find(arg) != binOpt.end();
+        if (arg == "-incremental" || arg == "-watch" || arg == "-j" || arg == "-log")
+        {
+            i += hasValue;
+            continue;
+        }
+
+        opts.childArgs.push_back(arg);
+        if (arg != "-q")
+            opts.signature += " " + arg;
+        if (hasValue && i + 1 < startIndex)
+        {
+            opts.childArgs.push_back(args[i + 1]);
+            opts.signature += " " + Ogre::String(args[++i]);
+        }
+    }
+
     if (unOpt["-q"])
     {
         opts.options.params |= AssimpLoader::LP_QUIET_MODE;
@@ -133,11 +294,117 @@ AssOptions parseArgs(int numArgs, char **args)
     {
         opts.options.params |= AssimpLoader::LP_CUT_ANIMATION_WHERE_NO_FURTHER_CHANGE;
     }
+    if (unOpt["-split16"])
+    {
+        opts.options.params |= AssimpLoader::LP_SPLIT_LARGE_MESHES;
+    }
+    if (unOpt["-bvh"])
+    {
+        opts.options.params |= AssimpLoader::LP_BUILD_BVH;
+    }
+    if (unOpt["-prune_bones"])
+    {
+        opts.options.params |= AssimpLoader::LP_PRUNE_UNUSED_BONES;
+    }
+    if (unOpt["-quantise_weights"])
+    {
+        opts.options.params |= AssimpLoader::LP_QUANTISE_BONE_WEIGHTS;
+    }
+    if (unOpt["-regex"])
+    {
+        opts.options.params |= AssimpLoader::LP_REGEX_FILTERS;
+    }
+    if (unOpt["-no_materials"])
+    {
+        opts.options.params |= AssimpLoader::LP_SKIP_MATERIALS;
+    }
+    if (unOpt["-no_normals"])
+    {
+        opts.options.params |= AssimpLoader::LP_SKIP_NORMALS;
+    }
+    if (unOpt["-no_uvs"])
+    {
+        opts.options.params |= AssimpLoader::LP_SKIP_UVS;
+    }
+    if (unOpt["-geometry_only"])
+    {
+        opts.options.params |= AssimpLoader::LP_GEOMETRY_ONLY;
+    }
+    if (unOpt["-animations_only"])
+    {
+        opts.options.params |= AssimpLoader::LP_ANIMATIONS_ONLY;
+    }
+    if (unOpt["-low_memory"])
+    {
+        opts.options.params |= AssimpLoader::LP_LOW_MEMORY;
+    }
+    if (unOpt["-tangents"])
+    {
+        opts.options.params |= AssimpLoader::LP_EXPORT_TANGENTS;
+    }
+    if (unOpt["-share_skeletons"])
+    {
+        opts.options.params |= AssimpLoader::LP_SHARE_SKELETONS;
+    }
+    if (unOpt["-parallel_postprocess"])
+    {
+        opts.options.params |= AssimpLoader::LP_PARALLEL_POSTPROCESS;
+    }
 
     opts.logFile = binOpt["-log"];
+    LogSink::getSingleton().setVerbosity(
+        LogSink::Level(std::min(Ogre::StringConverter::parseUnsignedInt(binOpt["-verbosity"], 3), unsigned(LogSink::LEVEL_TRACE))));
+    LogSink::getSingleton().setSummarise(unOpt["-summarise_log"]);
     Ogre::StringConverter::parse(binOpt["-aniSpeedMod"], opts.options.animationSpeedModifier);
     opts.options.customAnimationName = binOpt["-aniName"];
     Ogre::StringConverter::parse(binOpt["-max_edge_angle"], opts.options.maxEdgeAngle);
+    opts.options.maxBoneInfluences = Ogre::StringConverter::parseUnsignedInt(binOpt["-max_influences"], 4);
+    opts.options.maxBonesPerSubMesh = Ogre::StringConverter::parseUnsignedInt(binOpt["-max_palette"], 0);
+    opts.options.animations = Ogre::StringUtil::split(binOpt["-anims"], ",");
+    opts.options.nodeFilter = binOpt["-node_filter"];
+    opts.options.meshFilter = binOpt["-mesh_filter"];
+    opts.options.threads = Ogre::StringConverter::parseUnsignedInt(binOpt["-threads"]);
+    opts.options.chunkSize = Ogre::StringConverter::parseReal(binOpt["-chunk_size"]);
+#if OGRE_VERSION >= ((1 << 16) | (12 << 8) | 0)
+    if (binOpt["-tangent_format"] == "int10")
+        opts.options.tangentType = Ogre::VET_INT_10_10_10_2_NORM;
+#endif
+
+    opts.benchLoads = Ogre::StringConverter::parseUnsignedInt(binOpt["-bench"]);
+    SceneCache::getSingleton().setBudget(size_t(Ogre::StringConverter::parseUnsignedInt(binOpt["-scene_cache"])) << 20);
+    opts.incremental = unOpt["-incremental"] || unOpt["-watch"];
+    opts.watch = unOpt["-watch"];
+    opts.jobs = Ogre::StringConverter::parseUnsignedInt(binOpt["-j"]);
+    if (!opts.jobs)
+        opts.jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    opts.splitAnimations = unOpt["-split_anims"];
+    opts.writeBlob = unOpt["-blob"];
+    opts.buildEdgeLists = unOpt["-edge_lists"];
+    opts.atlasSize = Ogre::StringConverter::parseUnsignedInt(binOpt["-atlas"]);
+    opts.animationTarget = binOpt["-anims_onto"];
+    if (!binOpt["-bone_map"].empty())
+    {
+        std::ifstream boneMap(binOpt["-bone_map"].c_str());
+        if (!boneMap)
+        {
+            logMgr->logError("Could not open bone map " + binOpt["-bone_map"]);
+            exit(1);
+        }
+        Ogre::String line;
+        while (std::getline(boneMap, line))
+        {
+            Ogre::StringVector names = Ogre::StringUtil::split(line);
+            if (names.size() == 2)
+                opts.options.boneNameMap[names[0]] = names[1];
+        }
+    }
+    for (const Ogre::String& group : Ogre::StringUtil::split(binOpt["-anim_groups"], ";"))
+    {
+        Ogre::StringVector nameAndClips = Ogre::StringUtil::split(group, ":");
+        if (nameAndClips.size() == 2)
+            opts.animationGroups[nameAndClips[0]] = Ogre::StringUtil::split(nameAndClips[1], ",");
+    }
 
     // Source / dest
     if (numArgs > startIndex)
@@ -179,6 +446,537 @@ AssOptions parseArgs(int numArgs, char **args)
 
     return opts;
 }
+/// peak resident set size of the process in bytes
+size_t getPeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * size_t(1024);
+#endif
+#endif
+}
+
+/// writes via a per-process temporary file, so parallel children never see or produce a partial skeleton
+void exportSharedSkeleton(Ogre::SkeletonSerializer& serializer, Ogre::Skeleton* skeleton, const Ogre::String& path)
+{
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    const Ogre::String tmp = path + ".tmp" + Ogre::StringConverter::toString(pid);
+    serializer.exportSkeleton(skeleton, tmp);
+    // POSIX replaces atomically, Windows refuses when another child got there first with the same contents
+    if(std::rename(tmp.c_str(), path.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
+
+/// appends the clips of opts.source to opts.animationTarget and writes it back
+void appendAnimations(const AssOptions& opts, Ogre::StringVector& outputs, Ogre::StringVector& dependencies)
+{
+    Ogre::String basename, path;
+    Ogre::StringUtil::splitFilename(opts.animationTarget, basename, path);
+
+    Ogre::Archive* archive = Ogre::ArchiveManager::getSingleton().load(path.empty() ? "." : path, "FileSystem", true);
+    Ogre::DataStreamPtr stream = archive->open(basename);
+    Ogre::SkeletonPtr skeleton = Ogre::SkeletonManager::getSingleton().create(basename, Ogre::RGN_DEFAULT, true);
+    Ogre::SkeletonSerializer binSer;
+    binSer.importSkeleton(stream, skeleton.get());
+    stream.reset();
+    Ogre::ArchiveManager::getSingleton().unload(archive);
+
+    AssimpLoader loader;
+    if (!loader.loadAnimations(opts.source, skeleton, opts.options))
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "Could not import the animations of " + opts.source, "appendAnimations");
+    dependencies = loader.getDependencies();
+
+    binSer.exportSkeleton(skeleton.get(), opts.animationTarget);
+    outputs.push_back(opts.animationTarget);
+}
+
+/// writes the converted files of opts.source, returns their names and the files read
+void convert(const AssOptions& opts, Ogre::StringVector& outputs, Ogre::StringVector& dependencies)
+{
+    if (!opts.animationTarget.empty())
+    {
+        appendAnimations(opts, outputs, dependencies);
+        return;
+    }
+
+    Ogre::String basename, ext, path;
+    Ogre::StringUtil::splitFullFilename(opts.source, basename, ext, path);
+    Ogre::ResourceGroupManager::getSingleton().addResourceLocation(path, "FileSystem");
+
+    Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().createManual(basename+"."+ext, Ogre::RGN_DEFAULT);
+    Ogre::SkeletonPtr skeleton;
+
+    AssimpLoader loader;
+    if (!loader.load(opts.source, mesh.get(), skeleton, opts.options))
+        OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "Could not import " + opts.source, "convert");
+    dependencies = loader.getDependencies();
+
+    TextureAtlas atlas;
+    if(opts.atlasSize)
+    {
+        if(Ogre::Codec::getExtensions().empty())
+            OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS,
+                        "-atlas needs an image codec, but this build of the converter has none", "convert");
+
+        std::vector<Ogre::Mesh*> meshes(1, mesh.get());
+        for(const AssimpLoader::Chunk& chunk : loader.getChunks())
+            meshes.push_back(chunk.mesh.get());
+
+        atlas.maxSize = opts.atlasSize;
+        // the BVH refers to the submeshes by index
+        atlas.mergeSubMeshes = !(opts.options.params & AssimpLoader::LP_BUILD_BVH);
+        atlas.build(meshes, basename, Ogre::RGN_DEFAULT);
+
+        const TextureAtlas::Report& report = atlas.getReport();
+        logMgr->logMessage(Ogre::StringUtil::format("Texture atlases: %zu materials reduced to %zu, %zu draw calls reduced to %zu",
+                                                    report.materialsBefore, report.materialsAfter,
+                                                    report.drawCallsBefore, report.drawCallsAfter));
+        if(!(opts.options.params & AssimpLoader::LP_QUIET_MODE))
+        {
+            for(const Ogre::String& reason : report.ineligible)
+                logMgr->logMessage("Not atlased: " + reason);
+        }
+    }
+
+    // after atlasing, which merges submeshes
+    if(opts.buildEdgeLists)
+    {
+        std::vector<Ogre::Mesh*> meshes(1, mesh.get());
+        for(const AssimpLoader::Chunk& chunk : loader.getChunks())
+            meshes.push_back(chunk.mesh.get());
+
+        AssimpLoader::EdgeListReport report;
+        AssimpLoader::buildEdgeLists(meshes, opts.options.threads, report);
+        logMgr->logMessage(Ogre::StringUtil::format("Edge lists: %zu edges, %zu open, %zu non-manifold",
+                                                    report.edges, report.openEdges, report.nonManifoldEdges));
+        for(const Ogre::String& warning : report.warnings)
+            logMgr->logWarning(warning);
+    }
+
+    if(!opts.dest.empty())
+    {
+        path = opts.dest + "/";
+    }
+
+    for(size_t i = 0; i < atlas.getImages().size(); ++i)
+    {
+        atlas.getImages()[i].save(path + atlas.getImageNames()[i]);
+        outputs.push_back(path + atlas.getImageNames()[i]);
+    }
+
+    Ogre::MeshSerializer meshSer;
+    if(mesh->getNumSubMeshes())
+    {
+        meshSer.exportMesh(mesh.get(), path + basename + ".mesh");
+        outputs.push_back(path + basename + ".mesh");
+
+        if(opts.writeBlob)
+        {
+            MeshBlobSerializer::exportMesh(mesh.get(), path + basename + ".meshblob");
+            outputs.push_back(path + basename + ".meshblob");
+        }
+    }
+
+    if(!loader.getChunks().empty())
+    {
+        // index of the chunks, one line per chunk: cell x y z, bounds min and max, mesh file
+        std::ofstream index((path + basename + ".chunks").c_str());
+        index << "# chunk_size " << opts.options.chunkSize << "\n";
+        for(const AssimpLoader::Chunk& chunk : loader.getChunks())
+        {
+            meshSer.exportMesh(chunk.mesh.get(), path + chunk.mesh->getName());
+            outputs.push_back(path + chunk.mesh->getName());
+            if(opts.writeBlob)
+            {
+                Ogre::String blobName = chunk.mesh->getName().substr(0, chunk.mesh->getName().size() - 5) + ".meshblob";
+                MeshBlobSerializer::exportMesh(chunk.mesh.get(), path + blobName);
+                outputs.push_back(path + blobName);
+            }
+
+            const Ogre::Vector3& bmin = chunk.bounds.getMinimum();
+            const Ogre::Vector3& bmax = chunk.bounds.getMaximum();
+            index << chunk.x << " " << chunk.y << " " << chunk.z << " "
+                  << bmin.x << " " << bmin.y << " " << bmin.z << " "
+                  << bmax.x << " " << bmax.y << " " << bmax.z << " " << chunk.mesh->getName() << "\n";
+        }
+        outputs.push_back(path + basename + ".chunks");
+    }
+
+    if(opts.options.params & AssimpLoader::LP_BUILD_BVH)
+    {
+        loader.getBVH().exportBVH(path + basename + ".bvh");
+        outputs.push_back(path + basename + ".bvh");
+    }
+
+    if(skeleton)
+    {
+        Ogre::SkeletonSerializer binSer;
+
+        if(opts.splitAnimations)
+        {
+            std::vector<Ogre::SkeletonPtr> animationSkeletons;
+            AssimpLoader::splitAnimations(skeleton, opts.animationGroups, animationSkeletons);
+            for(const Ogre::SkeletonPtr& animSkel : animationSkeletons)
+            {
+                binSer.exportSkeleton(animSkel.get(), path + animSkel->getName());
+                outputs.push_back(path + animSkel->getName());
+            }
+        }
+
+        // a shared skeleton is named after its contents, so an existing file is the same skeleton
+        const Ogre::String skeletonPath = path + skeleton->getName();
+        if(!(opts.options.params & AssimpLoader::LP_SHARE_SKELETONS))
+            binSer.exportSkeleton(skeleton.get(), skeletonPath);
+        else if(!std::ifstream(skeletonPath.c_str()).good())
+            exportSharedSkeleton(binSer, skeleton.get(), skeletonPath);
+        else if(!(opts.options.params & AssimpLoader::LP_QUIET_MODE))
+            logMgr->logMessage("Linking to existing " + skeletonPath);
+        outputs.push_back(path + skeleton->getName());
+    }
+
+    // serialise the materials
+    std::set<Ogre::String> exportNames;
+    for(Ogre::SubMesh* sm : mesh->getSubMeshes())
+        exportNames.insert(sm->getMaterialName());
+    for(const AssimpLoader::Chunk& chunk : loader.getChunks())
+    {
+        for(Ogre::SubMesh* sm : chunk.mesh->getSubMeshes())
+            exportNames.insert(sm->getMaterialName());
+    }
+
+    // queue up the materials for serialise
+    Ogre::MaterialSerializer ms;
+    bool queued = false;
+    for(const Ogre::String& name : exportNames)
+    {
+        // submeshes imported without materials keep the default material
+        Ogre::MaterialPtr mat = Ogre::MaterialManager::getSingleton().getByName(name);
+        if(!mat || name == "BaseWhite")
+            continue;
+        ms.queueForExport(mat);
+        queued = true;
+    }
+
+    if(queued)
+    {
+        ms.exportQueued(path + basename + ".material");
+        outputs.push_back(path + basename + ".material");
+    }
+
+    if(!(opts.options.params & AssimpLoader::LP_QUIET_MODE))
+    {
+        logMgr->logMessage("Peak memory use: " + Ogre::StringConverter::toString(getPeakMemory() / (1024 * 1024)) + " MB");
+    }
+}
+
+/// loads opts.source benchLoads times with one loader, like an application loading many files
+void benchmark(const AssOptions& opts)
+{
+    Ogre::String basename, ext, path;
+    Ogre::StringUtil::splitFullFilename(opts.source, basename, ext, path);
+    Ogre::ResourceGroupManager::getSingleton().addResourceLocation(path, "FileSystem");
+
+    AssimpLoader loader;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < opts.benchLoads; ++i)
+    {
+        Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().createManual(basename+"."+ext, Ogre::RGN_DEFAULT);
+        Ogre::SkeletonPtr skeleton;
+        if (!loader.load(opts.source, mesh.get(), skeleton, opts.options))
+            OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS, "Could not import " + opts.source, "benchmark");
+
+        Ogre::MeshManager::getSingleton().remove(mesh->getHandle());
+        for (const AssimpLoader::Chunk& chunk : loader.getChunks())
+            Ogre::MeshManager::getSingleton().remove(chunk.mesh->getHandle());
+        if (skeleton)
+            Ogre::SkeletonManager::getSingleton().remove(skeleton->getHandle());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    logMgr->logMessage(Ogre::StringUtil::format("%u loads in %.3f s, %.1f loads per second", opts.benchLoads, seconds,
+                                                seconds > 0 ? opts.benchLoads / seconds : 0.0));
+    if (SceneCache::getSingleton().isEnabled())
+    {
+        SceneCache::Stats stats = SceneCache::getSingleton().getStats();
+        logMgr->logMessage(Ogre::StringUtil::format("Scene cache: %zu hits, %zu misses, %zu evictions, %.1f MB",
+                                                    stats.hits, stats.misses, stats.evictions, stats.bytes / 1048576.0));
+    }
+}
+
+bool getFileStamp(const Ogre::String& file, long long& mtime, long long& size)
+{
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0)
+        return false;
+    mtime = st.st_mtime;
+    size = st.st_size;
+    return true;
+}
+
+Ogre::String getDepsFileName(const Ogre::String& source, const Ogre::String& dest)
+{
+    Ogre::String basename, ext, path;
+    Ogre::StringUtil::splitFullFilename(source, basename, ext, path);
+    if (!dest.empty())
+        path = dest + "/";
+    return path + basename + ".deps";
+}
+
+/** the .deps file lists the options, the inputs and the outputs of a conversion
+    options <signature>
+    in <mtime> <size> <file>
+    out <file>
+    The conversion is up to date if the options match, no input changed and all outputs exist.
+*/
+bool isUpToDate(const Ogre::String& depsFile, const Ogre::String& signature)
+{
+    std::ifstream in(depsFile.c_str());
+    if (!in)
+        return false;
+
+    Ogre::String line;
+    if (!std::getline(in, line) || line != "options" + signature)
+        return false;
+
+    bool hasInputs = false;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        Ogre::String kind, file;
+        long long mtime, size, curMtime, curSize;
+        fields >> kind;
+        if (kind == "in")
+        {
+            fields >> mtime >> size;
+            std::getline(fields >> std::ws, file);
+            if (!getFileStamp(file, curMtime, curSize) || curMtime != mtime || curSize != size)
+                return false;
+            hasInputs = true;
+        }
+        else if (kind == "out")
+        {
+            std::getline(fields >> std::ws, file);
+            if (!getFileStamp(file, curMtime, curSize))
+                return false;
+        }
+    }
+
+    return hasInputs;
+}
+
+void writeDepsFile(const Ogre::String& depsFile, const Ogre::String& signature,
+                   const Ogre::StringVector& dependencies, const Ogre::StringVector& outputs)
+{
+    std::ofstream out(depsFile.c_str());
+    out << "options" << signature << "\n";
+    for (const Ogre::String& file : dependencies)
+    {
+        long long mtime, size;
+        // files Assimp probed but that do not exist on disk (e.g. stream loads) are not tracked
+        if (getFileStamp(file, mtime, size))
+            out << "in " << mtime << " " << size << " " << file << "\n";
+    }
+    for (const Ogre::String& file : outputs)
+        out << "out " << file << "\n";
+}
+
+/// creates dir and its missing parents, existing ones are fine
+void createDirectories(const Ogre::String& dir)
+{
+    for (size_t pos = dir.find('/', 1);; pos = dir.find('/', pos + 1))
+    {
+        Ogre::String part = dir.substr(0, pos);
+#ifdef _WIN32
+        CreateDirectoryA(part.c_str(), NULL);
+#else
+        mkdir(part.c_str(), 0755);
+#endif
+        if (pos == Ogre::String::npos)
+            break;
+    }
+}
+
+#ifdef _WIN32
+/// quotes arg so CommandLineToArgvW and the C runtime split it back unchanged
+Ogre::String quoteArgument(const Ogre::String& arg)
+{
+    Ogre::String quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : arg)
+    {
+        if (c == '\\')
+        {
+            backslashes++;
+            continue;
+        }
+        // backslashes only escape when a quote follows them
+        quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        quoted += c;
+        backslashes = 0;
+    }
+    quoted.append(backslashes * 2, '\\');
+    return quoted + "\"";
+}
+#endif
+
+/// runs args[0] with the arguments args without a shell, returns its exit code or -1
+int runChild(const Ogre::StringVector& args)
+{
+#ifdef _WIN32
+    Ogre::String commandLine;
+    for (const Ogre::String& arg : args)
+        commandLine += (commandLine.empty() ? "" : " ") + quoteArgument(arg);
+
+    STARTUPINFOA startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION processInfo = {};
+    if (!CreateProcessA(NULL, &commandLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &processInfo))
+        return -1;
+    WaitForSingleObject(processInfo.hProcess, INFINITE);
+    DWORD exitCode = DWORD(-1);
+    GetExitCodeProcess(processInfo.hProcess, &exitCode);
+    CloseHandle(processInfo.hProcess);
+    CloseHandle(processInfo.hThread);
+    return int(exitCode);
+#else
+    std::vector<char*> argv;
+    for (const Ogre::String& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(NULL);
+
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], NULL, NULL, argv.data(), environ) != 0)
+        return -1;
+    int status;
+    if (waitpid(pid, &status, 0) != pid)
+        return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+/// converts the stale files of opts.source, a file or a directory, in parallel child processes
+int convertStale(const AssOptions& opts, bool isDirectory)
+{
+    Ogre::StringVector files;
+    Ogre::String root;
+    if (isDirectory)
+    {
+        Ogre::Archive* archive = Ogre::ArchiveManager::getSingleton().load(opts.source, "FileSystem", true);
+        files = *archive->list(true);
+        Ogre::ArchiveManager::getSingleton().unload(archive);
+        root = opts.source + "/";
+    }
+    else
+    {
+        files.push_back(opts.source);
+    }
+
+    Assimp::Importer importer;
+    std::vector<Ogre::StringVector> stale;
+    size_t upToDate = 0;
+    for (const Ogre::String& file : files)
+    {
+        Ogre::String basename, ext, path;
+        Ogre::StringUtil::splitFullFilename(file, basename, ext, path);
+        if (isDirectory && (ext.empty() || !importer.IsExtensionSupported("." + ext)))
+            continue;
+
+        Ogre::String source = root + file;
+        // files of subdirectories keep their relative path below the destination, so equal basenames don't collide
+        Ogre::String dest = opts.dest;
+        if (isDirectory && !dest.empty() && !path.empty())
+        {
+            dest += "/" + path.substr(0, path.size() - 1);
+            createDirectories(dest);
+        }
+
+        Ogre::String depsFile = getDepsFileName(source, dest);
+        if (isUpToDate(depsFile, opts.signature))
+        {
+            upToDate++;
+            continue;
+        }
+
+        // every conversion logs next to its .deps file
+        Ogre::String logFile = depsFile.substr(0, depsFile.size() - 5) + ".log";
+        Ogre::StringVector command = opts.childArgs;
+        command.push_back("-log");
+        command.push_back(logFile);
+        command.push_back(source);
+        if (!dest.empty())
+            command.push_back(dest);
+        stale.push_back(command);
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failed(0);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < std::min<size_t>(opts.jobs, stale.size()); ++i)
+    {
+        workers.emplace_back([&]() {
+            for (size_t j = next++; j < stale.size(); j = next++)
+            {
+                if (runChild(stale[j]) != 0)
+                    failed++;
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+
+    if (!stale.empty() || !opts.watch)
+    {
+        logMgr->logMessage(Ogre::StringUtil::format("%zu files up to date, %zu converted, %zu failed",
+                                                    upToDate, stale.size() - failed, size_t(failed)));
+    }
+    return failed ? 1 : 0;
+}
+
+int convertIncremental(const AssOptions& opts)
+{
+    struct stat st;
+    bool isDirectory = stat(opts.source.c_str(), &st) == 0 && (st.st_mode & S_IFDIR);
+
+    if (!isDirectory && !opts.watch)
+    {
+        Ogre::String depsFile = getDepsFileName(opts.source, opts.dest);
+        if (isUpToDate(depsFile, opts.signature))
+        {
+            logMgr->logMessage(opts.source + " is up to date");
+            return 0;
+        }
+
+        Ogre::StringVector outputs, dependencies;
+        convert(opts, outputs, dependencies);
+        writeDepsFile(depsFile, opts.signature, dependencies, outputs);
+        return 0;
+    }
+
+    // the converter state is not reset between conversions, so watching runs them in child processes
+    int retCode;
+    do
+    {
+        retCode = convertStale(opts, isDirectory);
+        if (opts.watch)
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+    } while (opts.watch);
+
+    return retCode;
+}
 }
 
 int main(int numargs, char** args)
@@ -223,43 +1021,25 @@ int main(int numargs, char** args)
         Ogre::ArchiveManager::getSingleton().addArchiveFactory( mfsarchf );
 
         texMgr = new Ogre::DefaultTextureManager();
+#ifdef HAVE_FREEIMAGE_CODEC
+        Ogre::FreeImageCodec::startup();
+#elif defined(HAVE_STBI_CODEC)
+        Ogre::STBIImageCodec::startup();
+#endif
 
-        Ogre::String basename, ext, path;
-        Ogre::StringUtil::splitFullFilename(opts.source, basename, ext, path);
-        Ogre::ResourceGroupManager::getSingleton().addResourceLocation(path, "FileSystem");
-
-        Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().createManual(basename+"."+ext, Ogre::RGN_DEFAULT);
-        Ogre::SkeletonPtr skeleton;
-
-        AssimpLoader loader;
-        loader.load(opts.source, mesh.get(), skeleton, opts.options);
-
-        if(!opts.dest.empty())
+        if (opts.benchLoads)
         {
-            path = opts.dest + "/";
+            benchmark(opts);
         }
-
-        Ogre::MeshSerializer meshSer;
-        meshSer.exportMesh(mesh.get(), path + basename + ".mesh");
-
-        if(skeleton)
+        else if (opts.incremental)
         {
-            Ogre::SkeletonSerializer binSer;
-            binSer.exportSkeleton(skeleton.get(), path + skeleton->getName());
+            retCode = convertIncremental(opts);
+        }
+        else
+        {
+            Ogre::StringVector outputs, dependencies;
+            convert(opts, outputs, dependencies);
         }
-
-        // serialise the materials
-        std::set<Ogre::String> exportNames;
-        for(Ogre::SubMesh* sm : mesh->getSubMeshes())
-            exportNames.insert(sm->getMaterialName());
-
-        // queue up the materials for serialise
-        Ogre::MaterialSerializer ms;
-        for(const Ogre::String& name : exportNames)
-            ms.queueForExport(Ogre::MaterialManager::getSingleton().getByName(name));
-
-        if(!exportNames.empty())
-            ms.exportQueued(path + basename + ".material");
     }
     catch(Ogre::Exception& e)
     {
@@ -267,6 +1047,11 @@ int main(int numargs, char** args)
         retCode = 1;
     }
 
+#ifdef HAVE_FREEIMAGE_CODEC
+    Ogre::FreeImageCodec::shutdown();
+#elif defined(HAVE_STBI_CODEC)
+    Ogre::STBIImageCodec::shutdown();
+#endif
     //delete xmlSkeletonSerializer;
     delete skeletonSerializer;
     //delete xmlMeshSerializer;
@@ -281,6 +1066,8 @@ int main(int numargs, char** args)
     delete lodMgr;
     delete mth;
     delete rgm;
+    // the drainer thread writes to the log until it is stopped
+    LogSink::getSingleton().shutdown();
     delete logMgr;
 
     return retCode;